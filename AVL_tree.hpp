@@ -13,7 +13,10 @@
 
 
  c'tors :
- AVL_tree (Binary_node* r=NULL); .............  O(1)
+ AVL_tree (Binary_node* r=NULL, std::pmr::memory_resource* resource); O(1)
+    the nodes are allocated from resource (global new/delete by default).
+    the d'tor doesn't visit the nodes when T is trivially destructible
+    and resource is a std::pmr::monotonic_buffer_resource
  
  AVL_tree (const AVL_tree & t); ..............  O(n)
     throws std::bad_alloc
@@ -26,10 +29,21 @@
  AVL_tree & operator+(AVL_tree & t); .........  O(n)
     throws std::bad_alloc
 
+ AVL_tree & operator+(AVL_tree && t); ........  O(n)
+    steals the nodes of t (no copy of T), t is left empty. if t uses another
+    memory resource, its elements are moved in new nodes instead
+    throws std::bad_alloc
+
 
  elements actions:
  void balanced_insert(const T & val); ........  O(log n)
+ void balanced_insert(T && val); .............  O(log n)
+ void emplace(Args&&... args); ...............  O(log n)
     throws AVL_tree::key_already_exists, std::bad_alloc
+    the node is allocated once the key is known not to be in the tree
+
+ bool try_emplace(Args&&... args); ...........  O(log n)
+    return false if the key exists. throws std::bad_alloc
  
  void balanced_delete (const T & val); .......  O(log n)
     throws AVL_tree::key_not_found, std::bad_alloc
@@ -39,11 +53,35 @@
  T& get (const T & val); .....................  O(log n)
     throws AVL_tree::key_nod_found
 
+ T* get_ptr (const T & val); .................  O(log n)
+    NULL if val isn't in the tree
+
+ int find_batch (const T* keys, int n, T** out) ...  O(n log n)
+    out[k]=get_ptr(keys[k]), return the number found. the lookups go down
+    the tree together, a level each in turn (see prefetch.hpp)
+
+
+ void build_sorted (It first, int n); ........  O(n)
+    the n elements from first, sorted and distinct, copied in the empty tree
+    throws std::bad_alloc (the tree stays empty)
+
+ void parallel_build (const T* first, int n); .  O(n log n / threads)
+    the tree must be empty. throws AVL_tree::key_already_exists (the tree
+    stays empty), std::bad_alloc
+
+ void parallel_for_each (F f) const; .........  O(n / threads)
+    f(const T &) called from several threads, in no particular order
+
+ Container_stats stats () const; .............  O(1)
+    counters of the Stats policy (Null_stats : zeros, Counting_stats)
+
 
  iterators :
  inorder_iterator in_begin() const; .......... O(1)
  inorder_iterator in_end() const; ............ O(1)
- inorder_iterator & operator++(); ............ O(h)=O(log n)
+ inorder_iterator & operator++(); ............ O(1)
+    each node keeps a pointer to the next one in order (_succ), kept up to
+    date by the inserts and deletes : one load per step, no climbing
 
  postorder_iterator post_begin() const; ...... O(1)
  postorder_iterator post_end() const; ........ O(1)
@@ -55,10 +93,18 @@
 #include <stdio.h>
 #include <cassert>
 #include <new>
+#include <utility>
+#include <type_traits>
+#include "pmr.hpp"
+#include "container_stats.hpp"
+#include "task_pool.hpp"
+#include "prefetch.hpp"
+#include <vector>
 using namespace std;
-template <class T>
+//Stats is the instrumentation policy (see container_stats.hpp)
+template <class T, class Stats = Null_stats>
 /*================================AVL tree====================================*/
-class AVL_tree {
+class AVL_tree : private Stats {
 
     /*------------------------AVL tree Binary node----------------------------*/
     class Binary_node {
@@ -68,8 +114,11 @@ class AVL_tree {
         Binary_node* _left;
         Binary_node* _right;
         Binary_node* _parent;
+        Binary_node* _succ; //next node in order, NULL for the last one
         Binary_node (const T & val, int h=0, Binary_node* l=NULL, Binary_node* r=NULL, Binary_node* p=NULL)
-                : _data(val), _height(h), _left(l), _right(r), _parent(p) {}
+                : _data(val), _height(h), _left(l), _right(r), _parent(p), _succ(NULL) {}
+        Binary_node (T && val, int h=0, Binary_node* l=NULL, Binary_node* r=NULL, Binary_node* p=NULL)
+                : _data(std::move(val)), _height(h), _left(l), _right(r), _parent(p), _succ(NULL) {}
         ~Binary_node() {
             if(_left) _left->_parent=NULL;
             if(_right) _right->_parent=NULL;
@@ -83,7 +132,7 @@ class AVL_tree {
             }
         }
         Binary_node (const Binary_node & b) :
-                _data(b._data), _height(b._height), _left(b._left), _right(b._right), _parent(b._parent){}
+                _data(b._data), _height(b._height), _left(b._left), _right(b._right), _parent(b._parent), _succ(b._succ){}
         Binary_node & operator=(const Binary_node &) = delete;
 
         int BF() {
@@ -100,7 +149,38 @@ class AVL_tree {
     /*------------------------------------------------------------------------*/
 
     Binary_node* root;
+    std::pmr::memory_resource* _resource;
 
+    template <class... Args>
+    Binary_node* make_node (Args&&... args) { //can throw bad_alloc
+        Stats::count_allocation();
+        return pmr_new<Binary_node>(_resource, std::forward<Args>(args)...);
+    }
+
+    void destroy_node (Binary_node* node) {
+        pmr_delete(_resource, node);
+    }
+
+    bool same_resource (const AVL_tree & t) const {
+        return _resource==t._resource || _resource->is_equal(*t._resource);
+    }
+
+    //the node before x in order, NULL if x is the first. O(log n)
+    static Binary_node* predecessor (Binary_node* x) {
+        if(x->_left) {
+            x=x->_left;
+            while(x->_right) x=x->_right;
+            return x;
+        }
+        while(x->_parent && x->_parent->_left==x) x=x->_parent;
+        return x->_parent;
+    }
+
+    static int floor_log2 (int n) {
+        int h=0;
+        while(n>>=1) h++;
+        return h;
+    }
 
 
 public:
@@ -126,42 +206,7 @@ public:
         }
 
         inorder_iterator & operator++() {
-            /*remarks: myself=the current node in this->_ptr*/
-
-            //if I visited myself, the next node to visit
-            //is the most left grand son of my right son
-            if(_ptr->_right) {
-                _ptr=_ptr->_right;
-                while(_ptr->_left)
-                    _ptr=_ptr->_left;
-            }
-
-                //check if we got to the end of the iteration
-            else if (!_ptr->_parent)
-                _ptr=NULL;
-
-                /*According to the inorder iteration, If I got to myself,
-                 I have already visited my left sub tree.
-                 If we got there, I don't have right son.*/
-
-                //If I'm left son of my father and I visited myself
-                //(left sub tree done+no right child),
-                //I know have to visit my father
-            else if (_ptr->_parent->_left==_ptr) {
-                assert(_ptr->_right==NULL);
-                _ptr=_ptr->_parent;
-            }
-            else {
-                //if we got here I am right son.
-                assert(_ptr->_right==NULL && _ptr->_parent->_right==_ptr);
-                while(_ptr->_parent!=NULL && _ptr->_parent->_right==_ptr)
-                    _ptr=_ptr->_parent;
-                if(!_ptr->_parent) _ptr=NULL;
-                else {
-                    assert(_ptr->_parent->_left==_ptr);
-                    _ptr=_ptr->_parent;
-                }
-            }
+            _ptr=_ptr->_succ;
             return *this;
         }
     };
@@ -238,6 +283,7 @@ public:
     /*----------roligns. return the new root. updates the _heights------------*/
     Binary_node* LL (Binary_node* B) {
         assert(B);
+        Stats::count_rotation();
         Binary_node* A=B->_left;
         assert(A);
 
@@ -263,6 +309,7 @@ public:
     }
     Binary_node* RR (Binary_node* B) {
         assert(B);
+        Stats::count_rotation();
         Binary_node* A=B->_right;
         assert(A);
 
@@ -330,14 +377,37 @@ public:
     }
     /*===============================Methodes=================================*/
 
-    AVL_tree (Binary_node* r=NULL) : root(r) {}
+    AVL_tree (Binary_node* r=NULL, std::pmr::memory_resource* resource=std::pmr::get_default_resource())
+            : root(r), _resource(resource) {}
     ~AVL_tree () {
-        AVL_tree::postorder_iterator it=post_begin();
-        while (it!=post_end()) {
-            Binary_node* to_delet = it.get();
-            ++it;
-            delete to_delet;
+        //an arena frees the nodes itself, no need to walk them
+        if(std::is_trivially_destructible<T>::value && pmr_releases_at_once(_resource)) return;
+        destroy_all();
+    }
+    /*destroy the nodes along the _succ chain. the links are cut first, so
+     the d'tor of a node doesn't touch its (maybe already freed) neighbours*/
+    void destroy_all () {
+        Binary_node* ptr=in_begin().get();
+        while (ptr) {
+            Binary_node* next=ptr->_succ;
+            ptr->_left=ptr->_right=ptr->_parent=NULL;
+            destroy_node(ptr);
+            ptr=next;
         }
+        root=NULL;
+    }
+    bool is_empty () const {
+        return !root;
+    }
+    std::pmr::memory_resource* resource () const {
+        return _resource;
+    }
+    //snapshot of the counters of Stats
+    Container_stats stats () const {
+        return Stats::counters();
+    }
+    void reset_stats () {
+        Stats::reset_counters();
     }
     
     //helper function to swap 2 nodes (don't change data and don't use copy c'tor of T)
@@ -427,38 +497,56 @@ public:
 
 
     }
-    //don't update the parent height. return the inserted node. can return NULL.
-    //can return 2 exceptions : std::bad_alloc and AVL_tree<T>::key_already_exist
-    Binary_node* insert (const T & val) {
-        Binary_node* node=new Binary_node(val);
+    //return the node under which val should be inserted (NULL if the tree is empty)
+    //can return 1 exception : AVL_tree<T>::key_already_exist
+    Binary_node* insertion_parent (const T & val) const {
         Binary_node* p=root;
-        if(!p) {
-            root=node;
-            return node;
-        }
+        if(!p) return NULL;
         while (1) {
+            Stats::count_comparisons(1);
             if(p->_data<val) {
-                if(!p->_right) {
-                    p->_right=node;
-                    node->_parent=p;
-                    return node;
-                }
+                if(!p->_right) return p;
                 p=p->_right;
             }
-            else if(p->_data==val) {
-               	 delete node;
-		 throw key_already_exists();
-            }
+            else if(p->_data==val)
+                throw key_already_exists();
             else {
-                if(!p->_left) {
-                    p->_left=node;
-                    node->_parent=p;
-                    return node;
-                }
+                if(!p->_left) return p;
                 p=p->_left;
             }
         }
     }
+    //link node as a son of p (at the root if p is NULL), and in the _succ chain. return node.
+    Binary_node* link (Binary_node* p, Binary_node* node) {
+        node->_parent=p;
+        if(!p) {
+            root=node;
+            node->_succ=NULL;
+        }
+        else if(p->_data<node->_data) {
+            p->_right=node;
+            node->_succ=p->_succ;
+            p->_succ=node;
+        }
+        else {
+            p->_left=node;
+            node->_succ=p;
+            Binary_node* pred=predecessor(node);
+            if(pred) pred->_succ=node;
+        }
+        return node;
+    }
+    //don't update the parent height. return the inserted node. can return NULL.
+    //can return 2 exceptions : std::bad_alloc and AVL_tree<T>::key_already_exist
+    //the node is allocated only after the search for val
+    Binary_node* insert (const T & val) {
+        Binary_node* p=insertion_parent(val);
+        return link(p, make_node(val));
+    }
+    Binary_node* insert (T && val) {
+        Binary_node* p=insertion_parent(val);
+        return link(p, make_node(std::move(val)));
+    }
     //don't update heights. return the parent of the deleted node. can return NULL.
     //can return 1 exception
     Binary_node* delet (const T & val) {
@@ -468,12 +556,16 @@ public:
         }
 
         while (1) {
+            Stats::count_comparisons(1);
             if(p->_data<val) {
                 if(!p->_right)
                     throw key_not_found();
                 p=p->_right;
             }
             else if(p->_data==val) { //We want to destroy p
+                //take p out of the _succ chain (the swap below keeps the order of the others)
+                Binary_node* pred=predecessor(p);
+                if(pred) pred->_succ=p->_succ;
                 if (p->_left && p->_right) { //We want to find the next element after p
                     inorder_iterator it(p);
                     ++it; //inorder iteration return the next element (inorder visit = sorted visit)
@@ -488,25 +580,25 @@ public:
                     if(p->_right) only_son=p->_right;
                     assert(only_son);
                     if(!parent) {
-                        delete p;
+                        destroy_node(p);
                         root=only_son;
                         only_son->_parent=NULL;
                     }
                     else if(parent->_right==p) {
-                        delete p;
+                        destroy_node(p);
                         parent->_right=only_son;
                         only_son->_parent=parent;
                     }
                     else {
                         assert(parent->_left==p);
-                        delete p;
+                        destroy_node(p);
                         parent->_left=only_son;
                         only_son->_parent=parent;
                     }
                 }
                 else {
                     if(!parent) root=NULL;
-                    delete p;
+                    destroy_node(p);
                 }
                 return parent;
             }
@@ -518,8 +610,8 @@ public:
         }
     }
 
-    void balanced_insert(const T & val) {
-        Binary_node* v=insert(val); //can throw exception
+    //update the heights and roll from the new node v up to the root
+    void rebalance_insert (Binary_node* v) {
         while (v->_parent) {
             Binary_node* p=v->_parent;
             if(p->_height >= v->_height+1)
@@ -534,6 +626,34 @@ public:
         }
     }
 
+    void balanced_insert(const T & val) {
+        rebalance_insert(insert(val)); //can throw exception
+    }
+
+    void balanced_insert(T && val) {
+        rebalance_insert(insert(std::move(val))); //can throw exception
+    }
+
+    //the element is built from args on the stack to be compared, then moved in its node
+    template <class... Args>
+    void emplace(Args&&... args) {
+        balanced_insert(T(std::forward<Args>(args)...)); //can throw exception
+    }
+
+    template <class... Args>
+    bool try_emplace(Args&&... args) { //can throw std::bad_alloc
+        T val(std::forward<Args>(args)...);
+        Binary_node* p;
+        try {
+            p=insertion_parent(val);
+        }
+        catch(key_already_exists &) {
+            return false;
+        }
+        rebalance_insert(link(p, make_node(std::move(val))));
+        return true;
+    }
+
     void balanced_delete (const T & val) {
         Binary_node* v=delet(val); //can throw exception
         while (v) {
@@ -545,16 +665,64 @@ public:
     }
 
     T& get (const T & val) const {
+        T* data=get_ptr(val);
+        if(!data) throw key_not_found();
+        return *data;
+    }
+    //same as get, but return NULL if val isn't in the tree
+    T* get_ptr (const T & val) const {
         Binary_node* ptr=root;
         while (ptr!=NULL) {
+            Stats::count_comparisons(1);
             if(ptr->_data<val)
                 ptr=ptr->_right;
             else if(ptr->_data==val)
-                return ptr->_data;
+                return &ptr->_data;
             else
                 ptr=ptr->_left;
         }
-        throw key_not_found();
+        return NULL;
+    }
+    int find_batch (const T* keys, int n, T** out) const {
+        class Lookup {
+        public:
+            int _key;
+            Binary_node* _node;
+        };
+        Lookup group[prefetch_group];
+        int in_flight=0, next=0, found=0;
+        while (in_flight<prefetch_group && next<n) {
+            group[in_flight]._key=next++;
+            group[in_flight++]._node=root;
+        }
+        while (in_flight) {
+            for (int s=0; s<in_flight; ) {
+                Lookup & l=group[s];
+                Binary_node* ptr=l._node;
+                const T & val=keys[l._key];
+                T* result=NULL;
+                if (ptr) {
+                    Stats::count_comparisons(1);
+                    if (ptr->_data<val) l._node=ptr->_right;
+                    else if (ptr->_data==val) result=&ptr->_data;
+                    else l._node=ptr->_left;
+                    if (!result && l._node) {
+                        prefetch_read(l._node);
+                        s++;
+                        continue;
+                    }
+                }
+                out[l._key]=result;
+                found+=result!=NULL;
+                if (next<n) {
+                    l._key=next++;
+                    l._node=root;
+                    s++;
+                }
+                else l=group[--in_flight]; //the last lookup takes the place, it steps now
+            }
+        }
+        return found;
     }
     /*
     operator() : bonus tu use the operator + between 2 trees.
@@ -569,8 +737,19 @@ public:
     the eaten tree t stays unchanged. At the end of the method,
      this contains all the elements in this and t that return true to the operator ().*/
     AVL_tree & operator+(AVL_tree & t) {
+        return absorb(t, false);
+    }
+    /*same as above, but the nodes of t are moved in this instead of copied
+     (no copy c'tor of T, no allocation of nodes). t is left empty.*/
+    AVL_tree & operator+(AVL_tree && t) {
+        return absorb(t, true);
+    }
+    AVL_tree & absorb(AVL_tree & t, bool steal) {
+        //nodes of another resource can't be kept : move their elements instead
+        bool move_data = steal && !same_resource(t);
+        steal = steal && !move_data;
 
-        int length1 = 0,length_to_delet=0, length2 = 0;
+        int length1 = 0,length_to_delet=0, length2 = 0, length2_to_delet=0;
 
         for (AVL_tree::inorder_iterator it = this->in_begin(); it != this->in_end(); ++it) {
             if(it.get_data().operator()())
@@ -579,12 +758,16 @@ public:
                 length_to_delet++;
         }
 
-        for (AVL_tree::inorder_iterator it = t.in_begin(); it != t.in_end(); ++it)
+        for (AVL_tree::inorder_iterator it = t.in_begin(); it != t.in_end(); ++it) {
             if(it.get_data().operator()())
                 length2++;
+            else if(steal)
+                length2_to_delet++;
+        }
 
         int length_dest=length1+length2;
         Binary_node **nodes_to_delet;
+        Binary_node **nodes2_to_delet;
         Binary_node **to_merge_array1;
         Binary_node **to_merge_array2;
         Binary_node **dest_array;
@@ -616,6 +799,16 @@ public:
             delete [] to_merge_array2;
             throw std::bad_alloc();
         }
+        try {
+            nodes2_to_delet = new Binary_node*[length2_to_delet];
+        }
+        catch(std::bad_alloc&) {
+            delete [] nodes_to_delet;
+            delete [] to_merge_array1;
+            delete [] to_merge_array2;
+            delete [] dest_array;
+            throw std::bad_alloc();
+        }
 
         int i=0;
         int i_=0;
@@ -628,30 +821,54 @@ public:
                 nodes_to_delet[i_++]= it.get();
         }
         for (int i=0; i<length_to_delet; i++) {
-            delete nodes_to_delet[i];
+            destroy_node(nodes_to_delet[i]);
 	    nodes_to_delet[i]=NULL;
         }
         delete [] nodes_to_delet;
         i=0;
-        for (AVL_tree::inorder_iterator it = t.in_begin(); it != t.in_end(); ++it) {
+        if(steal) {
+            //take the nodes of t as they are, Create_avl resets their links
+            i_=0;
+            for (AVL_tree::inorder_iterator it = t.in_begin(); it != t.in_end(); ++it) {
+                if(it.get_data().operator()()) {
+                    assert(i<length2);
+                    to_merge_array2[i++] = it.get();
+                }
+                else
+                    nodes2_to_delet[i_++]= it.get();
+            }
+            for (int i=0; i<length2_to_delet; i++)
+                destroy_node(nodes2_to_delet[i]);
+            t.root=NULL;
+        }
+        else for (AVL_tree::inorder_iterator it = t.in_begin(); it != t.in_end(); ++it) {
             if(it.get_data().operator()()) {
                 assert(i<length2);
                 try {
-                    to_merge_array2[i] = new Binary_node(it.get_data());
+                    if(move_data)
+                        to_merge_array2[i] = make_node(std::move(it.get_data()));
+                    else
+                        to_merge_array2[i] = make_node(it.get_data());
                 }
                 catch(std::bad_alloc&) {
                     for(int j=0; j<i; j++) {
-                        delete to_merge_array2[j];
+                        destroy_node(to_merge_array2[j]);
                     }
+                    //the rejected nodes of this are gone, link back the others
+                    root = Create_avl(to_merge_array1, length1);
                     delete [] to_merge_array1;
                     delete [] to_merge_array2;
                     delete [] dest_array;
+                    delete [] nodes2_to_delet;
                     throw std::bad_alloc();
                 }
                 i++;
             }
         }
 
+        delete [] nodes2_to_delet;
+        if(move_data) t.destroy_all();
+
         merge(to_merge_array1, length1, to_merge_array2, length2, dest_array, length_dest);
         delete [] to_merge_array1;
         delete [] to_merge_array2;
@@ -660,31 +877,137 @@ public:
         delete [] dest_array;
         return *this;
     }
-    static Binary_node* Create_avl (Binary_node** a, int n) {
-        if(n==1) {
-            a[0]->_height=0;
-            a[0]->_parent=NULL;
-            a[0]->_left=NULL;
-            a[0]->_right=NULL;
-            return a[0];
+    template <class It>
+    void build_sorted (It first, int n) {
+        assert(!root);
+        if(n<=0) return;
+        std::vector<Binary_node*> nodes(n, NULL);
+        try {
+            for (int i=0; i<n; i++, ++first) nodes[i]=make_node(*first);
         }
-        if(n<=0) return NULL;
+        catch(...) {
+            for (int i=0; i<n; i++) pmr_delete(_resource, nodes[i]);
+            throw;
+        }
+        root=Create_avl(nodes.data(), n);
+    }
+    /*the n elements of first in the empty tree, built in parallel : copies
+     sorted by parallel_sort, nodes allocated by ranges, then linked as by
+     Create_avl, the two halves of each big subtree by two tasks. the nodes
+     are allocated by the tasks only from a thread safe resource (see
+     pmr_thread_safe), sequentially otherwise. Stats doesn't count in here.*/
+    void parallel_build (const T* first, int n, Task_pool & pool=Task_pool::shared()) {
+        assert(!root);
+        if(n<=0) return;
+        std::vector<T> sorted(first, first+n);
+        parallel_sort(sorted.begin(), sorted.end(), std::less<T>(), pool);
+        for (int i=1; i<n; i++)
+            if(!(sorted[i-1]<sorted[i])) throw key_already_exists();
+
+        std::vector<Binary_node*> nodes(n, NULL);
+        auto allocate=[this, &nodes, &sorted](long long from, long long to) {
+            for (long long i=from; i<to; i++) nodes[i]=pmr_new<Binary_node>(_resource, std::move(sorted[i]));
+        };
+        try {
+            if(pmr_thread_safe(_resource)) parallel_ranges(0, n, allocate, pool);
+            else allocate(0, n);
+        }
+        catch(...) {
+            for (int i=0; i<n; i++) pmr_delete(_resource, nodes[i]);
+            throw;
+        }
+        root=parallel_create_avl(nodes.data(), n, pool);
+    }
+    /*call f(const T &) on each element, the sons of the subtrees higher than
+     parallel_height visited by different tasks : f is called from several
+     threads at once, in no particular order*/
+    template <class F>
+    void parallel_for_each (F f, Task_pool & pool=Task_pool::shared()) const {
+        parallel_visit(root, f, pool);
+    }
+    //subtrees under this height (about 2^12 nodes) are built/visited by a single task
+    static const int parallel_height=12;
+    static Binary_node* parallel_create_avl (Binary_node** a, int n, Task_pool & pool) {
+        if(n < (1<<parallel_height)) return Create_avl(a, n);
 
         int mid=n/2;
         Binary_node* root = a[mid];
-        Binary_node* left_sub_tree = Create_avl(a, mid);
-        Binary_node* right_sub_tree = Create_avl(a+mid+1, n-mid-1);
+        Binary_node* left_sub_tree = NULL;
+        Task_group group(pool);
+        group.run([&left_sub_tree, a, mid, &pool]() { left_sub_tree=parallel_create_avl(a, mid, pool); });
+        Binary_node* right_sub_tree = parallel_create_avl(a+mid+1, n-mid-1, pool);
+        group.wait();
 
         root->_parent=NULL;
         root->_left=left_sub_tree;
         root->_right=right_sub_tree;
-        if(left_sub_tree) left_sub_tree->_parent=root;
-        if(right_sub_tree) right_sub_tree->_parent=root;
-
+        left_sub_tree->_parent=root;
+        right_sub_tree->_parent=root;
         root->_height=root->H();
+        a[mid-1]->_succ=root; //the two halves were threaded apart
+        root->_succ=a[mid+1];
         assert(root->BF()<=1 && root->BF()>=-1);
         return root;
     }
+    template <class F>
+    static void parallel_visit (Binary_node* node, F & f, Task_pool & pool) {
+        if(!node) return;
+        if(node->_height < parallel_height) {
+            visit(node, f);
+            return;
+        }
+        Task_group group(pool);
+        group.run([node, &f, &pool]() { parallel_visit(node->_left, f, pool); });
+        f((const T &)node->_data);
+        parallel_visit(node->_right, f, pool);
+        group.wait();
+    }
+    template <class F>
+    static void visit (Binary_node* node, F & f) { //inorder, recursive
+        if(!node) return;
+        visit(node->_left, f);
+        f((const T &)node->_data);
+        visit(node->_right, f);
+    }
+    /*link the n sorted nodes of a in a balanced tree and in the _succ chain,
+     return the root. iterative, with a stack of the ranges left to link : a
+     range of k nodes is split at k/2, so its subtree has height floor(log2 k),
+     known before its sons are linked. the stack never holds more than
+     log2(n)+1 ranges.*/
+    static Binary_node* Create_avl (Binary_node** a, int n) {
+        if(n<=0) return NULL;
+        for (int i=0; i<n; i++) a[i]->_succ = i+1<n ? a[i+1] : NULL;
+
+        class Range {
+        public:
+            int _from;
+            int _n;
+            Binary_node* _parent;
+            bool _left;
+        };
+        Range stack[64];
+        int top=0;
+        stack[top++]={0, n, NULL, false};
+        Binary_node* root=NULL;
+        while(top) {
+            Range r=stack[--top];
+            int mid=r._from+r._n/2;
+            Binary_node* node=a[mid];
+            node->_height=floor_log2(r._n);
+            node->_left=NULL;
+            node->_right=NULL;
+            node->_parent=r._parent;
+            if(!r._parent) root=node;
+            else if(r._left) r._parent->_left=node;
+            else r._parent->_right=node;
+
+            int right_n=r._n-r._n/2-1;
+            if(right_n>0) stack[top++]={mid+1, right_n, node, false};
+            if(r._n/2>0) stack[top++]={r._from, r._n/2, node, true};
+            assert(top<=64);
+        }
+        return root;
+    }
     static void merge(Binary_node** a,int na, Binary_node** b, int nb, Binary_node** c, int nc){
         int ia =0, ib=0, ic=0;
         while(ia<na && ib<nb) {
@@ -0,0 +1,217 @@
+//
+//  bench.hpp
+//  wet2
+//
+//  Minimal benchmark harness shared by the bench executables : options,
+//  timing and a report written as a table or as JSON.
+//
+
+#ifndef bench_hpp
+#define bench_hpp
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/*
+ usage : <bench> [--min-size=N] [--max-size=N] [--repeats=R] [--filter=S] [--json=FILE]
+
+ The sizes go from min-size to max-size (1K to 1M by default, up to 100M)
+ by factors of 10. Each benchmark runs repeats times per size and keeps the
+ fastest run. --json=FILE writes the results as JSON (--json=- to stdout,
+ the table then goes to stderr), to be kept and compared between commits.
+ */
+class Bench_options {
+public:
+    long long _min_size;
+    long long _max_size;
+    int _repeats;
+    std::string _filter;
+    std::string _json;
+    Bench_options () : _min_size(1000), _max_size(1000000), _repeats(3) {}
+
+    //unknown arguments are left to the caller, return false on a bad option
+    bool parse (int argc, char** argv) {
+        for (int i=1; i<argc; i++) {
+            const char* a=argv[i];
+            if(!strncmp(a, "--min-size=", 11)) _min_size=atoll(a+11);
+            else if(!strncmp(a, "--max-size=", 11)) _max_size=atoll(a+11);
+            else if(!strncmp(a, "--repeats=", 10)) _repeats=atoi(a+10);
+            else if(!strncmp(a, "--filter=", 9)) _filter=a+9;
+            else if(!strncmp(a, "--json=", 7)) _json=a+7;
+            else if(!strncmp(a, "--", 2)) {
+                fprintf(stderr, "unknown option %s\n", a);
+                return false;
+            }
+        }
+        if(_min_size<1) _min_size=1;
+        if(_repeats<1) _repeats=1;
+        return true;
+    }
+
+    std::vector<long long> sizes () const {
+        std::vector<long long> s;
+        for (long long n=_min_size; n<=_max_size; n*=10) s.push_back(n);
+        return s;
+    }
+
+    bool selected (const std::string & name) const {
+        return _filter.empty() || name.find(_filter)!=std::string::npos;
+    }
+};
+
+/*time of the measured part of a run, the setup stays out of start/stop*/
+class Bench_timer {
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point _start;
+    double _seconds;
+public:
+    Bench_timer () : _seconds(0) {}
+    void start () {
+        _start=Clock::now();
+    }
+    void stop () {
+        _seconds+=std::chrono::duration<double>(Clock::now()-_start).count();
+    }
+    double seconds () const {
+        return _seconds;
+    }
+};
+
+//keep the compiler from dropping a computation whose result is unused
+inline void bench_keep (long long x) {
+    static volatile long long sink;
+    sink=sink+x;
+}
+
+class Bench_result {
+public:
+    std::string _name; //benchmark/size
+    std::string _container;
+    std::string _operation;
+    long long _size;
+    long long _ops;
+    double _seconds;
+    std::vector<std::pair<std::string, double> > _counters; //extra numbers (hit ratio...)
+
+    double ns_per_op () const {
+        return _ops ? _seconds*1e9/_ops : 0;
+    }
+    double ops_per_sec () const {
+        return _seconds>0 ? _ops/_seconds : 0;
+    }
+};
+
+class Bench_report {
+    Bench_options _options;
+    std::vector<Bench_result> _results;
+    FILE* _table;
+
+    static void json_string (FILE* out, const std::string & s) {
+        fputc('"', out);
+        for (size_t i=0; i<s.size(); i++) {
+            if(s[i]=='"' || s[i]=='\\') fputc('\\', out);
+            fputc(s[i], out);
+        }
+        fputc('"', out);
+    }
+
+public:
+    explicit Bench_report (const Bench_options & options) : _options(options) {
+        _table = _options._json=="-" ? stderr : stdout;
+    }
+
+    const Bench_options & options () const {
+        return _options;
+    }
+
+    /*time run(Bench_timer &) repeats times, keep the fastest. ops is the number
+     of operations timed in one run. return the result to add counters to,
+     NULL if the benchmark is filtered out*/
+    template <class F>
+    Bench_result* run (const char* container, const char* operation, long long size, long long ops, F run) {
+        std::string name=std::string(container)+"/"+operation+"/"+std::to_string(size);
+        if(!_options.selected(name)) return NULL;
+        double best=0;
+        for (int r=0; r<_options._repeats; r++) {
+            Bench_timer timer;
+            run(timer);
+            if(r==0 || timer.seconds()<best) best=timer.seconds();
+        }
+        Bench_result result;
+        result._name=name;
+        result._container=container;
+        result._operation=operation;
+        result._size=size;
+        result._ops=ops;
+        result._seconds=best;
+        _results.push_back(result);
+        fprintf(_table, "%-48s %12.2f ns/op %14.0f ops/s\n", name.c_str(), result.ns_per_op(), result.ops_per_sec());
+        fflush(_table);
+        return &_results.back();
+    }
+
+    //a result measured by the caller (several threads...)
+    Bench_result* add (const Bench_result & result) {
+        if(!_options.selected(result._name)) return NULL;
+        _results.push_back(result);
+        fprintf(_table, "%-48s %12.2f ns/op %14.0f ops/s\n", result._name.c_str(), result.ns_per_op(), result.ops_per_sec());
+        for (size_t i=0; i<result._counters.size(); i++)
+            fprintf(_table, "    %s=%g\n", result._counters[i].first.c_str(), result._counters[i].second);
+        fflush(_table);
+        return &_results.back();
+    }
+
+    void write_json (FILE* out) const {
+        char date[32];
+        time_t now=time(NULL);
+        strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+        fprintf(out, "{\n  \"context\": {\n    \"date\": \"%s\",\n    \"num_cpus\": %u,\n", date, std::thread::hardware_concurrency());
+#ifdef NDEBUG
+        fprintf(out, "    \"assertions\": false,\n");
+#else
+        fprintf(out, "    \"assertions\": true,\n");
+#endif
+        fprintf(out, "    \"repeats\": %d\n  },\n  \"benchmarks\": [", _options._repeats);
+        for (size_t i=0; i<_results.size(); i++) {
+            const Bench_result & r=_results[i];
+            fprintf(out, "%s\n    {\"name\": ", i ? "," : "");
+            json_string(out, r._name);
+            fprintf(out, ", \"container\": ");
+            json_string(out, r._container);
+            fprintf(out, ", \"operation\": ");
+            json_string(out, r._operation);
+            fprintf(out, ", \"size\": %lld, \"ops\": %lld, \"seconds\": %.9g, \"ns_per_op\": %.6g, \"ops_per_sec\": %.6g",
+                    r._size, r._ops, r._seconds, r.ns_per_op(), r.ops_per_sec());
+            for (size_t j=0; j<r._counters.size(); j++) {
+                fprintf(out, ", ");
+                json_string(out, r._counters[j].first);
+                fprintf(out, ": %.9g", r._counters[j].second);
+            }
+            fprintf(out, "}");
+        }
+        fprintf(out, "\n  ]\n}\n");
+    }
+
+    //write the JSON where --json asked, return false if the file can't be written
+    bool finish () const {
+        if(_options._json.empty()) return true;
+        if(_options._json=="-") {
+            write_json(stdout);
+            return true;
+        }
+        FILE* out=fopen(_options._json.c_str(), "w");
+        if(!out) {
+            fprintf(stderr, "can't write %s\n", _options._json.c_str());
+            return false;
+        }
+        write_json(out);
+        return fclose(out)==0;
+    }
+};
+#endif /* bench_hpp */
@@ -0,0 +1,685 @@
+//
+//  bench_containers.cpp
+//  wet2
+//
+//  Hash_table, AVL_tree, Min_heap and the lists against their std
+//  counterparts (unordered_set, set, priority_queue, list).
+//  usage : bench_containers [--max-size=N] [--json=FILE] ... (see bench.hpp)
+//
+
+#include <stdio.h>
+#include <algorithm>
+#include <functional>
+#include <list>
+#include <random>
+#include <queue>
+#include <set>
+#include <unordered_set>
+#include <atomic>
+#include <vector>
+#include "bench.hpp"
+#include "../hash_table.hpp"
+#include "../dlist.hpp"
+#include "../unrolled_list.hpp"
+#include "../AVL_tree.hpp"
+#include "../flat_ordered_set.hpp"
+#include "../min_heap.hpp"
+#include "../external_sort.hpp"
+
+//the operations in O(n) per element only run up to this size
+static const long long quadratic_max=10000;
+
+//keys per call of find_batch, as a request path looking up 64 to 512 keys at once
+static const int batch_size=256;
+
+//distinct keys in a random looking order (multiplication by an odd number is a bijection mod 2^31)
+static int key_of (long long i) {
+    return (int)(((unsigned)i*2654435761u)&0x7fffffff);
+}
+
+/*the n keys in another order than the insertions : the nodes of consecutive
+ lookups aren't next to each other in memory (a lookup in insertion order
+ finds its node where the previous one was allocated)*/
+template <class K>
+static std::vector<K> shuffled_keys (long long n) {
+    std::vector<K> keys;
+    keys.reserve(n);
+    for (long long i=0; i<n; i++) keys.push_back(K(key_of(i)));
+    std::shuffle(keys.begin(), keys.end(), std::mt19937_64(n));
+    return keys;
+}
+
+class Hash_key {
+public:
+    int _v;
+    Hash_key (int v=0) : _v(v) {}
+    bool operator==(const Hash_key & k) const {
+        return _v==k._v;
+    }
+    int operator()() const { //the keys are already spread
+        return _v;
+    }
+};
+
+class Tree_key {
+public:
+    int _v;
+    Tree_key (int v=0) : _v(v) {}
+    bool operator==(const Tree_key & k) const {
+        return _v==k._v;
+    }
+    bool operator<(const Tree_key & k) const {
+        return _v<k._v;
+    }
+    bool operator()() const { //operator + keeps every element
+        return true;
+    }
+};
+
+/*---------------------------------hash tables--------------------------------*/
+static void hash_table_benchs (Bench_report & report, long long n) {
+    report.run("Hash_table", "insert", n, n, [&](Bench_timer & t) {
+        Hash_table<Hash_key> h;
+        t.start();
+        for (long long i=0; i<n; i++) h.insert(Hash_key(key_of(i)));
+        t.stop();
+    });
+    report.run("Hash_table", "insert_reserved", n, n, [&](Bench_timer & t) {
+        Hash_table<Hash_key> h;
+        h.reserve((int)n);
+        t.start();
+        for (long long i=0; i<n; i++) h.insert(Hash_key(key_of(i)));
+        t.stop();
+    });
+    Hash_table<Hash_key> h;
+    for (long long i=0; i<n; i++) h.insert(Hash_key(key_of(i)));
+    report.run("Hash_table", "resize", n, n, [&](Bench_timer & t) {
+        int buckets=h.bucket_count();
+        t.start();
+        h.rehash(2*buckets);
+        t.stop();
+        h.rehash(buckets);
+    });
+    report.run("Hash_table", "find_hit", n, n, [&](Bench_timer & t) {
+        long long found=0;
+        t.start();
+        for (long long i=0; i<n; i++) found+=h.find_ptr(Hash_key(key_of(i)))!=NULL;
+        t.stop();
+        bench_keep(found);
+    });
+    report.run("Hash_table", "find_miss", n, n, [&](Bench_timer & t) {
+        long long found=0;
+        t.start();
+        for (long long i=0; i<n; i++) found+=h.find_ptr(Hash_key(key_of(n+i)))!=NULL;
+        t.stop();
+        bench_keep(found);
+    });
+    report.run("Hash_table", "find_shuffled", n, n, [&](Bench_timer & t) {
+        std::vector<Hash_key> keys=shuffled_keys<Hash_key>(n);
+        long long found=0;
+        t.start();
+        for (long long i=0; i<n; i++) found+=h.find_ptr(keys[i])!=NULL;
+        t.stop();
+        bench_keep(found);
+    });
+    report.run("Hash_table", "find_batch", n, n, [&](Bench_timer & t) { //the same keys as find_shuffled
+        std::vector<Hash_key> keys=shuffled_keys<Hash_key>(n);
+        Hash_key* out[batch_size];
+        long long found=0;
+        t.start();
+        for (long long i=0; i<n; i+=batch_size)
+            found+=h.find_batch(&keys[i], (int)std::min<long long>(batch_size, n-i), out);
+        t.stop();
+        bench_keep(found);
+    });
+    report.run("Hash_table", "erase", n, n, [&](Bench_timer & t) {
+        Hash_table<Hash_key> e;
+        for (long long i=0; i<n; i++) e.insert(Hash_key(key_of(i)));
+        t.start();
+        for (long long i=0; i<n; i++) e.erase(Hash_key(key_of(i)));
+        t.stop();
+    });
+
+    report.run("std::unordered_set", "insert", n, n, [&](Bench_timer & t) {
+        std::unordered_set<int> s;
+        t.start();
+        for (long long i=0; i<n; i++) s.insert(key_of(i));
+        t.stop();
+    });
+    report.run("std::unordered_set", "insert_reserved", n, n, [&](Bench_timer & t) {
+        std::unordered_set<int> s;
+        s.reserve(n);
+        t.start();
+        for (long long i=0; i<n; i++) s.insert(key_of(i));
+        t.stop();
+    });
+    std::unordered_set<int> s;
+    for (long long i=0; i<n; i++) s.insert(key_of(i));
+    report.run("std::unordered_set", "resize", n, n, [&](Bench_timer & t) {
+        size_t buckets=s.bucket_count();
+        t.start();
+        s.rehash(2*buckets);
+        t.stop();
+        s.rehash(buckets);
+    });
+    report.run("std::unordered_set", "find_hit", n, n, [&](Bench_timer & t) {
+        long long found=0;
+        t.start();
+        for (long long i=0; i<n; i++) found+=s.count(key_of(i));
+        t.stop();
+        bench_keep(found);
+    });
+    report.run("std::unordered_set", "find_miss", n, n, [&](Bench_timer & t) {
+        long long found=0;
+        t.start();
+        for (long long i=0; i<n; i++) found+=s.count(key_of(n+i));
+        t.stop();
+        bench_keep(found);
+    });
+    report.run("std::unordered_set", "erase", n, n, [&](Bench_timer & t) {
+        std::unordered_set<int> e;
+        for (long long i=0; i<n; i++) e.insert(key_of(i));
+        t.start();
+        for (long long i=0; i<n; i++) e.erase(key_of(i));
+        t.stop();
+    });
+}
+
+/*------------------------------ordered sets----------------------------------*/
+static void avl_tree_benchs (Bench_report & report, long long n) {
+    report.run("AVL_tree", "insert", n, n, [&](Bench_timer & t) {
+        AVL_tree<Tree_key> a;
+        t.start();
+        for (long long i=0; i<n; i++) a.balanced_insert(Tree_key(key_of(i)));
+        t.stop();
+    });
+    AVL_tree<Tree_key> a;
+    for (long long i=0; i<n; i++) a.balanced_insert(Tree_key(key_of(i)));
+    report.run("AVL_tree", "get", n, n, [&](Bench_timer & t) {
+        long long sum=0;
+        t.start();
+        for (long long i=0; i<n; i++) sum+=a.get(Tree_key(key_of(i)))._v;
+        t.stop();
+        bench_keep(sum);
+    });
+    report.run("AVL_tree", "get_shuffled", n, n, [&](Bench_timer & t) {
+        std::vector<Tree_key> keys=shuffled_keys<Tree_key>(n);
+        long long found=0;
+        t.start();
+        for (long long i=0; i<n; i++) found+=a.get_ptr(keys[i])!=NULL;
+        t.stop();
+        bench_keep(found);
+    });
+    report.run("AVL_tree", "get_batch", n, n, [&](Bench_timer & t) { //find_batch, the same keys as get_shuffled
+        std::vector<Tree_key> keys=shuffled_keys<Tree_key>(n);
+        Tree_key* out[batch_size];
+        long long found=0;
+        t.start();
+        for (long long i=0; i<n; i+=batch_size)
+            found+=a.find_batch(&keys[i], (int)std::min<long long>(batch_size, n-i), out);
+        t.stop();
+        bench_keep(found);
+    });
+    report.run("AVL_tree", "iterate", n, n, [&](Bench_timer & t) {
+        long long sum=0;
+        t.start();
+        for (AVL_tree<Tree_key>::inorder_iterator it=a.in_begin(); it!=a.in_end(); ++it) sum+=it.get_data()._v;
+        t.stop();
+        bench_keep(sum);
+    });
+    report.run("AVL_tree", "delete", n, n, [&](Bench_timer & t) {
+        AVL_tree<Tree_key> d;
+        for (long long i=0; i<n; i++) d.balanced_insert(Tree_key(key_of(i)));
+        t.start();
+        for (long long i=0; i<n; i++) d.balanced_delete(Tree_key(key_of(i)));
+        t.stop();
+    });
+    report.run("AVL_tree", "destroy", n, n, [&](Bench_timer & t) {
+        AVL_tree<Tree_key>* d=new AVL_tree<Tree_key>();
+        for (long long i=0; i<n; i++) d->balanced_insert(Tree_key(key_of(i)));
+        t.start();
+        delete d;
+        t.stop();
+    });
+    report.run("AVL_tree", "operator+", n, n, [&](Bench_timer & t) {
+        AVL_tree<Tree_key> x, y;
+        for (long long i=0; i<n; i++) {
+            if(i%2) x.balanced_insert(Tree_key(key_of(i)));
+            else y.balanced_insert(Tree_key(key_of(i)));
+        }
+        t.start();
+        x+y;
+        t.stop();
+    });
+
+    report.run("std::set", "insert", n, n, [&](Bench_timer & t) {
+        std::set<int> s;
+        t.start();
+        for (long long i=0; i<n; i++) s.insert(key_of(i));
+        t.stop();
+    });
+    std::set<int> s;
+    for (long long i=0; i<n; i++) s.insert(key_of(i));
+    report.run("std::set", "get", n, n, [&](Bench_timer & t) {
+        long long sum=0;
+        t.start();
+        for (long long i=0; i<n; i++) sum+=*s.find(key_of(i));
+        t.stop();
+        bench_keep(sum);
+    });
+    report.run("std::set", "iterate", n, n, [&](Bench_timer & t) {
+        long long sum=0;
+        t.start();
+        for (std::set<int>::const_iterator it=s.begin(); it!=s.end(); ++it) sum+=*it;
+        t.stop();
+        bench_keep(sum);
+    });
+    report.run("std::set", "delete", n, n, [&](Bench_timer & t) {
+        std::set<int> d;
+        for (long long i=0; i<n; i++) d.insert(key_of(i));
+        t.start();
+        for (long long i=0; i<n; i++) d.erase(key_of(i));
+        t.stop();
+    });
+    report.run("std::set", "destroy", n, n, [&](Bench_timer & t) {
+        std::set<int>* d=new std::set<int>();
+        for (long long i=0; i<n; i++) d->insert(key_of(i));
+        t.start();
+        delete d;
+        t.stop();
+    });
+    report.run("std::set", "operator+", n, n, [&](Bench_timer & t) { //copying union, as operator+
+        std::set<int> x, y;
+        for (long long i=0; i<n; i++) {
+            if(i%2) x.insert(key_of(i));
+            else y.insert(key_of(i));
+        }
+        t.start();
+        x.insert(y.begin(), y.end());
+        t.stop();
+    });
+}
+
+/*--------------small ordered sets : many sets of m elements-------------------*/
+template <class Set>
+static void small_set_benchs (Bench_report & report, const char* name, long long m) {
+    const long long total=1<<16;
+    long long sets_num=total/m;
+    report.run(name, "small_insert", m, total, [&](Bench_timer & t) {
+        std::vector<Set> sets(sets_num);
+        t.start();
+        for (long long s=0; s<sets_num; s++)
+            for (long long i=0; i<m; i++) sets[s].balanced_insert(Tree_key(key_of(s*m+i)));
+        t.stop();
+    });
+    std::vector<Set> sets(sets_num);
+    for (long long s=0; s<sets_num; s++)
+        for (long long i=0; i<m; i++) sets[s].balanced_insert(Tree_key(key_of(s*m+i)));
+    report.run(name, "small_get", m, total, [&](Bench_timer & t) {
+        long long sum=0;
+        t.start();
+        for (long long s=0; s<sets_num; s++)
+            for (long long i=0; i<m; i++) sum+=sets[s].get(Tree_key(key_of(s*m+i)))._v;
+        t.stop();
+        bench_keep(sum);
+    });
+}
+
+static void std_small_set_benchs (Bench_report & report, long long m) {
+    const long long total=1<<16;
+    long long sets_num=total/m;
+    report.run("std::set", "small_insert", m, total, [&](Bench_timer & t) {
+        std::vector<std::set<int> > sets(sets_num);
+        t.start();
+        for (long long s=0; s<sets_num; s++)
+            for (long long i=0; i<m; i++) sets[s].insert(key_of(s*m+i));
+        t.stop();
+    });
+    std::vector<std::set<int> > sets(sets_num);
+    for (long long s=0; s<sets_num; s++)
+        for (long long i=0; i<m; i++) sets[s].insert(key_of(s*m+i));
+    report.run("std::set", "small_get", m, total, [&](Bench_timer & t) {
+        long long sum=0;
+        t.start();
+        for (long long s=0; s<sets_num; s++)
+            for (long long i=0; i<m; i++) sum+=*sets[s].find(key_of(s*m+i));
+        t.stop();
+        bench_keep(sum);
+    });
+}
+
+/*----------------------------------heaps-------------------------------------*/
+static void min_heap_benchs (Bench_report & report, long long n) {
+    report.run("Min_heap", "push", n, n, [&](Bench_timer & t) {
+        Min_heap<int> m;
+        t.start();
+        for (long long i=0; i<n; i++) m.insert(key_of(i));
+        t.stop();
+    });
+    report.run("Min_heap", "pop", n, n, [&](Bench_timer & t) {
+        Min_heap<int> m;
+        for (long long i=0; i<n; i++) m.insert(key_of(i));
+        long long sum=0;
+        t.start();
+        for (long long i=0; i<n; i++) {
+            sum+=m.find_min();
+            m.Del_min();
+        }
+        t.stop();
+        bench_keep(sum);
+    });
+    report.run("Min_heap", "Dec_key", n, n, [&](Bench_timer & t) {
+        Min_heap<int> m;
+        std::vector<Min_heap<int>::Node*> nodes(n);
+        for (long long i=0; i<n; i++) nodes[i]=m.insert(key_of(i));
+        t.start();
+        for (long long i=0; i<n; i++) m.Dec_key(nodes[i]->_index, nodes[i]->_data/2);
+        t.stop();
+    });
+    //the heads of merge_runs runs : the min goes out, the next record of its run comes in
+    const int merge_runs=1024;
+    report.run("Min_heap", "merge_pop_push", n, n, [&](Bench_timer & t) {
+        Min_heap<long long> m;
+        for (int r=0; r<merge_runs; r++) m.insert(key_of(r)&1023);
+        t.start();
+        for (long long i=0; i<n; i++) {
+            long long min=m.find_min();
+            m.Del_min();
+            m.insert(min+1+(key_of(i)&1023));
+        }
+        t.stop();
+        bench_keep(m.find_min());
+    });
+    report.run("Min_heap", "merge_replace_min", n, n, [&](Bench_timer & t) {
+        Min_heap<long long> m;
+        for (int r=0; r<merge_runs; r++) m.insert(key_of(r)&1023);
+        t.start();
+        for (long long i=0; i<n; i++) m.replace_min(m.find_min()+1+(key_of(i)&1023));
+        t.stop();
+        bench_keep(m.find_min());
+    });
+
+    typedef std::priority_queue<int, std::vector<int>, std::greater<int> > Std_heap;
+    report.run("std::priority_queue", "push", n, n, [&](Bench_timer & t) {
+        Std_heap q;
+        t.start();
+        for (long long i=0; i<n; i++) q.push(key_of(i));
+        t.stop();
+    });
+    report.run("std::priority_queue", "pop", n, n, [&](Bench_timer & t) {
+        Std_heap q;
+        for (long long i=0; i<n; i++) q.push(key_of(i));
+        long long sum=0;
+        t.start();
+        for (long long i=0; i<n; i++) {
+            sum+=q.top();
+            q.pop();
+        }
+        t.stop();
+        bench_keep(sum);
+    });
+}
+
+/*----------------parallel build and traversal (Task_pool)--------------------*/
+static void parallel_benchs (Bench_report & report, long long n) {
+    std::vector<Hash_key> hash_keys(n);
+    std::vector<Tree_key> tree_keys(n);
+    for (long long i=0; i<n; i++) {
+        hash_keys[i]=Hash_key(key_of(i));
+        tree_keys[i]=Tree_key(key_of(i));
+    }
+    Task_pool & pool=Task_pool::shared();
+    report.run("Hash_table", "parallel_insert", n, n, [&](Bench_timer & t) {
+        Hash_table<Hash_key> h;
+        t.start();
+        h.parallel_insert(hash_keys.data(), (int)n, pool);
+        t.stop();
+    });
+    Hash_table<Hash_key> h;
+    h.parallel_insert(hash_keys.data(), (int)n, pool);
+    report.run("Hash_table", "parallel_for_each", n, n, [&](Bench_timer & t) {
+        std::atomic<long long> sum(0);
+        t.start();
+        h.parallel_for_each([&sum](const Hash_key & k) { sum.fetch_add(k._v, std::memory_order_relaxed); }, pool);
+        t.stop();
+        bench_keep(sum);
+    });
+    report.run("AVL_tree", "parallel_build", n, n, [&](Bench_timer & t) {
+        AVL_tree<Tree_key> a;
+        t.start();
+        a.parallel_build(tree_keys.data(), (int)n, pool);
+        t.stop();
+    });
+    AVL_tree<Tree_key> a;
+    a.parallel_build(tree_keys.data(), (int)n, pool);
+    report.run("AVL_tree", "parallel_for_each", n, n, [&](Bench_timer & t) {
+        std::atomic<long long> sum(0);
+        t.start();
+        a.parallel_for_each([&sum](const Tree_key & k) { sum.fetch_add(k._v, std::memory_order_relaxed); }, pool);
+        t.stop();
+        bench_keep(sum);
+    });
+}
+
+/*------------------instrumented (Counting_stats) containers------------------*/
+//the counters of the last run go in the result, next to the cost of counting
+static void add_counters (Bench_result* result, const Container_stats & stats) {
+    if(!result) return;
+    stats.for_each_counter([result](const char* name, long long value) {
+        if(value) result->_counters.push_back(std::make_pair(std::string(name), (double)value));
+    });
+}
+
+static void instrumented_benchs (Bench_report & report, long long n) {
+    Container_stats stats;
+    Bench_result* r=report.run("Hash_table+Counting_stats", "insert", n, n, [&](Bench_timer & t) {
+        Hash_table<Hash_key, List<Hash_key>, Counting_stats> h;
+        t.start();
+        for (long long i=0; i<n; i++) h.insert(Hash_key(key_of(i)));
+        t.stop();
+        stats=h.stats();
+    });
+    add_counters(r, stats);
+    r=report.run("AVL_tree+Counting_stats", "insert", n, n, [&](Bench_timer & t) {
+        AVL_tree<Tree_key, Counting_stats> a;
+        t.start();
+        for (long long i=0; i<n; i++) a.balanced_insert(Tree_key(key_of(i)));
+        t.stop();
+        stats=a.stats();
+    });
+    add_counters(r, stats);
+    r=report.run("Min_heap+Counting_stats", "push", n, n, [&](Bench_timer & t) {
+        Min_heap<int, Counting_stats> m;
+        t.start();
+        for (long long i=0; i<n; i++) m.insert(key_of(i));
+        t.stop();
+        stats=m.stats();
+    });
+    add_counters(r, stats);
+}
+
+/*-----------------------------save / load------------------------------------*/
+/*to a tmpfile : mostly in the page cache, so the cost of the format and of
+ the rebuild rather than of the disk. bytes is the size of the snapshot*/
+static void add_bytes (Bench_result* result, FILE* file) {
+    if(result) result->_counters.push_back(std::make_pair(std::string("bytes"), (double)ftell(file)));
+}
+
+static void snapshot_benchs (Bench_report & report, long long n) {
+    Hash_table<Hash_key> h;
+    for (long long i=0; i<n; i++) h.insert(Hash_key(key_of(i)));
+    FILE* file=tmpfile();
+    if(!file) return;
+    Bench_result* r=report.run("Hash_table", "save", n, n, [&](Bench_timer & t) {
+        rewind(file);
+        t.start();
+        h.save(file);
+        t.stop();
+    });
+    add_bytes(r, file);
+    rewind(file);
+    h.save(file); //whatever the filter ran
+    report.run("Hash_table", "load", n, n, [&](Bench_timer & t) { //against insert, which resizes on the way
+        Hash_table<Hash_key> l;
+        rewind(file);
+        t.start();
+        l.load(file);
+        t.stop();
+    });
+    Min_heap<int> m;
+    for (long long i=0; i<n; i++) m.insert(key_of(i));
+    r=report.run("Min_heap", "save", n, n, [&](Bench_timer & t) {
+        rewind(file);
+        t.start();
+        m.save(file);
+        t.stop();
+    });
+    add_bytes(r, file);
+    rewind(file);
+    m.save(file);
+    report.run("Min_heap", "load", n, n, [&](Bench_timer & t) { //against push
+        Min_heap<int> l;
+        rewind(file);
+        t.start();
+        l.load(file);
+        t.stop();
+    });
+    fclose(file);
+}
+
+/*-------------------------------external sort--------------------------------*/
+class Sort_record {
+public:
+    unsigned long long _key;
+    unsigned long long _payload;
+    bool operator<(const Sort_record & r) const {
+        return _key<r._key;
+    }
+};
+
+//n records of 16 bytes, tmpfile to tmpfile, with memory for an eighth of them (8 runs)
+static void external_sort_benchs (Bench_report & report, long long n) {
+    FILE* in=tmpfile();
+    FILE* out=tmpfile();
+    if(!in || !out) {
+        if(in) fclose(in);
+        if(out) fclose(out);
+        return;
+    }
+    {
+        Run_writer<Sort_record> writer(in, 1<<16);
+        for (long long i=0; i<n; i++) {
+            Sort_record r;
+            r._key=mix_hash(i);
+            r._payload=i;
+            writer.push(r);
+        }
+        writer.flush();
+    }
+    size_t memory=(size_t)n*sizeof(Sort_record)/8;
+    if(memory<(4<<20)) memory=4<<20;
+    Bench_result* r=report.run("external_sort", "sort", n, n, [&](Bench_timer & t) {
+        rewind(in);
+        rewind(out);
+        t.start();
+        external_sort<Sort_record>(in, out, memory);
+        t.stop();
+    });
+    if(r) r->_counters.push_back(std::make_pair(std::string("memory_bytes"), (double)memory));
+    fclose(in);
+    fclose(out);
+}
+
+/*----------------------------------lists-------------------------------------*/
+template <class L>
+static void list_benchs (Bench_report & report, const char* name, long long n) {
+    report.run(name, "head_insert", n, n, [&](Bench_timer & t) {
+        L l;
+        t.start();
+        for (long long i=0; i<n; i++) l.head_insert(key_of(i));
+        t.stop();
+    });
+    report.run(name, "tail_insert", n, n, [&](Bench_timer & t) {
+        L l;
+        t.start();
+        for (long long i=0; i<n; i++) l.tail_insert(key_of(i));
+        t.stop();
+    });
+    report.run(name, "for_each", n, n, [&](Bench_timer & t) {
+        L l;
+        for (long long i=0; i<n; i++) l.tail_insert(key_of(i));
+        long long sum=0;
+        t.start();
+        l.for_each([&](const int & x) { sum+=x; });
+        t.stop();
+        bench_keep(sum);
+    });
+    if(n>quadratic_max) return;
+    report.run(name, "get_ptr", n, n, [&](Bench_timer & t) {
+        L l;
+        for (long long i=0; i<n; i++) l.tail_insert(key_of(i));
+        long long found=0;
+        t.start();
+        for (long long i=0; i<n; i++) found+=l.get_ptr(key_of(i))!=NULL;
+        t.stop();
+        bench_keep(found);
+    });
+    report.run(name, "delete_last", n, n, [&](Bench_timer & t) {
+        L l;
+        for (long long i=0; i<n; i++) l.tail_insert(key_of(i));
+        t.start();
+        for (long long i=0; i<n; i++) l.delete_last();
+        t.stop();
+    });
+}
+
+static void std_list_benchs (Bench_report & report, long long n) {
+    report.run("std::list", "head_insert", n, n, [&](Bench_timer & t) {
+        std::list<int> l;
+        t.start();
+        for (long long i=0; i<n; i++) l.push_front(key_of(i));
+        t.stop();
+    });
+    report.run("std::list", "tail_insert", n, n, [&](Bench_timer & t) {
+        std::list<int> l;
+        t.start();
+        for (long long i=0; i<n; i++) l.push_back(key_of(i));
+        t.stop();
+    });
+    report.run("std::list", "for_each", n, n, [&](Bench_timer & t) {
+        std::list<int> l;
+        for (long long i=0; i<n; i++) l.push_back(key_of(i));
+        long long sum=0;
+        t.start();
+        for (std::list<int>::const_iterator it=l.begin(); it!=l.end(); ++it) sum+=*it;
+        t.stop();
+        bench_keep(sum);
+    });
+}
+
+int main (int argc, char** argv) {
+    Bench_options options;
+    if(!options.parse(argc, argv)) return 2;
+    Bench_report report(options);
+    for (long long m=16; m<=256; m*=4) {
+        small_set_benchs<AVL_tree<Tree_key> >(report, "AVL_tree", m);
+        small_set_benchs<Flat_ordered_set<Tree_key> >(report, "Flat_ordered_set", m);
+        std_small_set_benchs(report, m);
+    }
+    std::vector<long long> sizes=options.sizes();
+    for (size_t i=0; i<sizes.size(); i++) {
+        long long n=sizes[i];
+        hash_table_benchs(report, n);
+        avl_tree_benchs(report, n);
+        min_heap_benchs(report, n);
+        instrumented_benchs(report, n);
+        parallel_benchs(report, n);
+        snapshot_benchs(report, n);
+        external_sort_benchs(report, n);
+        list_benchs<List<int> >(report, "List", n);
+        list_benchs<Dlist<int> >(report, "Dlist", n);
+        list_benchs<Unrolled_list<int> >(report, "Unrolled_list", n);
+        std_list_benchs(report, n);
+    }
+    return report.finish() ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+//
+//  cache_bench.cpp
+//  wet2
+//
+//  Replays Zipfian traces on Lru_cache, Clock_cache and Sharded_cache.
+//  usage : cache_bench [keys] [requests] [zipf exponent] [--json=FILE] ... (see bench.hpp)
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include "bench.hpp"
+#include "../lru_cache.hpp"
+
+/*trace of requests where the key of rank r is requested with probability ~ 1/r^s*/
+static std::vector<int> zipf_trace (int keys, int requests, double s, unsigned seed) {
+    std::vector<double> cdf(keys);
+    double sum=0;
+    for (int r=0; r<keys; r++) {
+        sum+=1.0/pow(r+1, s);
+        cdf[r]=sum;
+    }
+    std::mt19937_64 gen(seed);
+    std::uniform_real_distribution<double> uniform(0, sum);
+    std::vector<int> trace(requests);
+    for (int i=0; i<requests; i++)
+        trace[i]=(int)(std::lower_bound(cdf.begin(), cdf.end(), uniform(gen))-cdf.begin());
+    //spread the hot keys over the key space
+    for (int i=0; i<requests; i++)
+        trace[i]=(int)(((unsigned)trace[i]*2654435761u)&0x7fffffff);
+    return trace;
+}
+
+//the backend is the trace itself : on a miss, put the key as its own value
+template <class Cache>
+static void replay (Cache & cache, const std::vector<int> & trace, int from, int to) {
+    int value;
+    for (int i=from; i<to; i++) {
+        if(!cache.get(trace[i], value)) cache.put(trace[i], trace[i]);
+    }
+}
+
+static void add_result (Bench_report & report, const char* name, int capacity, const Cache_stats & s, int threads) {
+    Bench_result result;
+    result._name=std::string(name)+"/replay/"+std::to_string(capacity);
+    result._container=name;
+    result._operation="replay";
+    result._size=capacity;
+    result._ops=s.ops();
+    result._seconds=s._seconds;
+    result._counters.push_back(std::make_pair(std::string("hit_ratio"), s.hit_ratio()));
+    result._counters.push_back(std::make_pair(std::string("evictions"), (double)s._evictions));
+    result._counters.push_back(std::make_pair(std::string("threads"), (double)threads));
+    report.add(result);
+}
+
+template <class Cache>
+static void run (Bench_report & report, const char* name, int capacity, const std::vector<int> & trace) {
+    Cache cache(capacity);
+    replay(cache, trace, 0, (int)trace.size());
+    add_result(report, name, capacity, cache.stats(), 1);
+}
+
+static void run_sharded (Bench_report & report, int capacity, const std::vector<int> & trace, int threads) {
+    Sharded_cache<Clock_cache<int, int>, 16> cache(capacity);
+    std::vector<std::thread> workers;
+    int chunk=(int)trace.size()/threads;
+    for (int t=0; t<threads; t++) {
+        int end = t==threads-1 ? (int)trace.size() : (t+1)*chunk; //the last thread takes the remainder
+        workers.push_back(std::thread(replay<Sharded_cache<Clock_cache<int, int>, 16> >,
+                                      std::ref(cache), std::cref(trace), t*chunk, end));
+    }
+    for (size_t t=0; t<workers.size(); t++) workers[t].join();
+    add_result(report, "sharded_clock", capacity, cache.stats(), threads);
+}
+
+int main (int argc, char** argv) {
+    Bench_options options;
+    if(!options.parse(argc, argv)) return 2;
+    Bench_report report(options);
+    //the positional arguments, the options start with --
+    std::vector<const char*> args;
+    for (int i=1; i<argc; i++)
+        if(strncmp(argv[i], "--", 2)) args.push_back(argv[i]);
+    int keys=args.size()>0 ? atoi(args[0]) : 1000000;
+    int requests=args.size()>1 ? atoi(args[1]) : 10000000;
+    double s=args.size()>2 ? atof(args[2]) : 0.99;
+    if(keys<10) {
+        fprintf(stderr, "cache_bench : needs at least 10 keys (the caches hold 1%% to 10%% of them)\n");
+        return 2;
+    }
+    std::vector<int> trace=zipf_trace(keys, requests, s, 42);
+    int threads=(int)std::thread::hardware_concurrency();
+    if(threads<1) threads=1;
+
+    for (int capacity=std::max(1, keys/100); capacity<=keys/10; capacity*=10) {
+        run<Lru_cache<int, int> >(report, "lru", capacity, trace);
+        run<Clock_cache<int, int> >(report, "clock", capacity, trace);
+        if(capacity>=16) run_sharded(report, capacity, trace, threads); //a slot per shard at least
+    }
+    return report.finish() ? 0 : 1;
+}
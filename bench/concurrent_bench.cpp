@@ -0,0 +1,174 @@
+//
+//  concurrent_bench.cpp
+//  wet2
+//
+//  Stress check of Concurrent_list and Concurrent_hash_set, then the
+//  scaling of Concurrent_hash_set against a Hash_table behind a mutex.
+//  usage : concurrent_bench [max threads] [--max-size=N] [--json=FILE] ... (see bench.hpp)
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bench.hpp"
+#include "../concurrent_list.hpp"
+#include "../concurrent_hash_set.hpp"
+#include "../hash_table.hpp"
+
+class Key {
+public:
+    int _v;
+    Key (int v=0) : _v(v) {}
+    bool operator==(const Key & k) const {
+        return _v==k._v;
+    }
+    bool operator<(const Key & k) const {
+        return _v<k._v;
+    }
+    int operator()() const {
+        return _v;
+    }
+};
+
+//run f(t) on threads threads, return when all are done
+template <class F>
+static void on_threads (int threads, F f) {
+    std::vector<std::thread> workers;
+    for (int t=0; t<threads; t++) workers.push_back(std::thread(f, t));
+    for (size_t t=0; t<workers.size(); t++) workers[t].join();
+}
+
+/*---------------------------------stress-------------------------------------*/
+static bool check (bool ok, const char* what) {
+    if(!ok) fprintf(stderr, "stress : %s failed\n", what);
+    return ok;
+}
+
+/*each thread inserts its own keys and erases half of them while all read
+ everything, then all the threads fight over the same keys : the final
+ content and the number of successful inserts/erases must add up*/
+template <class Set>
+static bool stress (const char* name, int threads, int n) {
+    Set set;
+    std::atomic<bool> ok(true);
+    on_threads(threads, [&](int t) {
+        for (int i=t; i<n; i+=threads)
+            if(!set.insert(Key(i))) ok=false;
+        for (int i=t; i<n; i+=2*threads)
+            if(!set.erase(Key(i))) ok=false;
+        for (int i=0; i<n; i++) set.contains(Key(i));
+    });
+    bool good=check(ok, "insert/erase of own keys");
+    for (int i=0; i<n; i++) {
+        bool expected = i%(2*threads)>=threads;
+        if(set.contains(Key(i))!=expected) {
+            good=check(false, "content after own keys");
+            break;
+        }
+    }
+
+    std::atomic<long long> inserted(0), erased(0);
+    on_threads(threads, [&](int) {
+        for (int round=0; round<4; round++) {
+            for (int i=n; i<2*n; i++) inserted+=set.insert(Key(i));
+            for (int i=n; i<2*n; i+=2) erased+=set.erase(Key(i));
+        }
+    });
+    long long present=0;
+    for (int i=n; i<2*n; i++) present+=set.contains(Key(i));
+    good&=check(inserted-erased==present, "shared keys count");
+    long long walked=0;
+    set.for_each([&walked](const Key &) { walked++; });
+    long long own=0;
+    for (int i=0; i<n; i++) own+=i%(2*threads)>=threads;
+    good&=check(walked==own+present, "for_each count");
+    printf("stress %-20s %d threads : %s\n", name, threads, good ? "ok" : "FAILED");
+    return good;
+}
+
+/*----------------------------------scaling-----------------------------------*/
+class Locked_table {
+    std::mutex _lock;
+    Hash_table<Key> _table;
+public:
+    bool insert (const Key & k) {
+        std::lock_guard<std::mutex> guard(_lock);
+        if(_table.find_ptr(k)) return false;
+        _table.insert(k);
+        return true;
+    }
+    bool erase (const Key & k) {
+        std::lock_guard<std::mutex> guard(_lock);
+        if(!_table.find_ptr(k)) return false;
+        _table.erase(k);
+        return true;
+    }
+    bool contains (const Key & k) {
+        std::lock_guard<std::mutex> guard(_lock);
+        return _table.find_ptr(k)!=NULL;
+    }
+};
+
+/*n keys, half of them in the set, then ops operations split on the threads :
+ 80% contains, 10% insert, 10% erase of random keys*/
+template <class Set>
+static void mixed (Bench_report & report, const char* name, long long n, int threads) {
+    long long ops = n<1000000 ? 1000000 : n;
+    std::string operation="mixed_"+std::to_string(threads)+"t";
+    Bench_result* r=report.run(name, operation.c_str(), n, ops, [&](Bench_timer & timer) {
+        Set set;
+        for (long long i=0; i<n; i+=2) set.insert(Key((int)i));
+        std::atomic<long long> found(0);
+        timer.start();
+        on_threads(threads, [&](int t) {
+            unsigned long long x=mix_hash(t+1);
+            long long hits=0;
+            for (long long i=0; i<ops/threads; i++) {
+                x^=x<<13;
+                x^=x>>7;
+                x^=x<<17;
+                Key k((int)(x%n));
+                int op=(int)((x>>32)%10);
+                if(op==0) hits+=set.insert(k);
+                else if(op==1) hits+=set.erase(k);
+                else hits+=set.contains(k);
+            }
+            found+=hits;
+        });
+        timer.stop();
+        bench_keep(found);
+    });
+    if(r) r->_counters.push_back(std::make_pair(std::string("threads"), (double)threads));
+}
+
+int main (int argc, char** argv) {
+    Bench_options options;
+    if(!options.parse(argc, argv)) return 2;
+    Bench_report report(options);
+    std::vector<const char*> args;
+    for (int i=1; i<argc; i++)
+        if(strncmp(argv[i], "--", 2)) args.push_back(argv[i]);
+    int max_threads=args.size()>0 ? atoi(args[0]) : (int)std::thread::hardware_concurrency();
+    if(max_threads<1) max_threads=1;
+
+    int stress_threads = max_threads<4 ? 4 : max_threads; //interleavings even on few cores
+    bool ok=stress<Concurrent_hash_set<Key> >("Concurrent_hash_set", stress_threads, 100000);
+    ok&=stress<Concurrent_list<Key> >("Concurrent_list", stress_threads, 2000);
+    if(!ok) return 1;
+
+    std::vector<long long> sizes=options.sizes();
+    for (size_t i=0; i<sizes.size(); i++) {
+        for (int threads=1; ; threads*=2) {
+            if(threads>max_threads) threads=max_threads;
+            mixed<Concurrent_hash_set<Key> >(report, "Concurrent_hash_set", sizes[i], threads);
+            mixed<Locked_table>(report, "Hash_table+mutex", sizes[i], threads);
+            if(threads==max_threads) break;
+        }
+    }
+    return report.finish() ? 0 : 1;
+}
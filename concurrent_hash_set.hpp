@@ -0,0 +1,250 @@
+//
+//  concurrent_hash_set.hpp
+//  wet2
+//
+//  Lock-free hash set (split-ordered list of Shalev and Shavit) over the
+//  chain of concurrent_list.hpp.
+//
+
+#ifndef concurrent_hash_set_hpp
+#define concurrent_hash_set_hpp
+#include <stdio.h>
+#include <stdint.h>
+#include <cassert>
+#include <atomic>
+#include <utility>
+#include "concurrent_list.hpp"
+#include "hash_table.hpp"
+
+/*
+ needed operators for T : == and () (the hash, as for Hash_table)
+
+ All the elements are in one lock-free chain (Harris_chain), sorted by the
+ bits of their hash reversed. The buckets are shortcuts in the chain : the
+ bucket b is a head node (never deleted) at the place of reverse(b), and
+ the elements of hash h come right after the head of bucket h%buckets.
+ Doubling the buckets moves no element : the new bucket b+buckets takes the
+ second half of the elements after the head of b, whose reversed hashes are
+ bigger. The head of a bucket is linked on its first use, from the head of
+ its parent bucket (b without its highest bit).
+
+ insert, erase ...... lock-free, O(1) expected
+ contains, get ...... wait-free, O(1) expected (an unused bucket is read
+                      through its parent, not linked)
+
+ The number of buckets doubles when the load goes over max_load, it never
+ shrinks. The bucket array is in segments of doubling sizes, allocated on
+ first use and never moved.
+
+ Any thread can call any method at any time, but the d'tor. The nodes come
+ from global new/delete, see Concurrent_list.
+ */
+template <class T>
+class Concurrent_hash_set {
+    typedef Harris_chain<T> Chain;
+    typedef typename Chain::Node Node;
+    typedef std::atomic<Node*> Bucket;
+
+    static const int max_segments=48; //segment s>0 has the buckets [2^(s-1), 2^s), up to 2^47 buckets
+
+    std::atomic<Bucket*> _segments[max_segments];
+    std::atomic<uint64_t> _buckets; //a power of 2
+    std::atomic<long long> _size;
+    float _max_load;
+    Node _head; //head of the bucket 0, the head of the whole chain
+
+    static uint64_t reverse_bits (uint64_t x) {
+        x=((x>>1)&0x5555555555555555ULL) | ((x&0x5555555555555555ULL)<<1);
+        x=((x>>2)&0x3333333333333333ULL) | ((x&0x3333333333333333ULL)<<2);
+        x=((x>>4)&0x0f0f0f0f0f0f0f0fULL) | ((x&0x0f0f0f0f0f0f0f0fULL)<<4);
+        x=((x>>8)&0x00ff00ff00ff00ffULL) | ((x&0x00ff00ff00ff00ffULL)<<8);
+        x=((x>>16)&0x0000ffff0000ffffULL) | ((x&0x0000ffff0000ffffULL)<<16);
+        return (x>>32) | (x<<32);
+    }
+
+    static int floor_log2 (uint64_t x) {
+        int log=0;
+        for (int shift=32; shift; shift/=2) {
+            if(x>>shift) {
+                x>>=shift;
+                log+=shift;
+            }
+        }
+        return log;
+    }
+
+    //63 bits, so the reversed hash has its low bit free for the mark of the elements
+    static uint64_t hash_of (const T & val) {
+        return mix_hash((uint64_t)val.operator()())>>1;
+    }
+
+    static int segment_of (uint64_t b) {
+        return b ? floor_log2(b)+1 : 0;
+    }
+    static uint64_t segment_start (int s) {
+        return s ? 1ULL<<(s-1) : 0;
+    }
+    static uint64_t segment_length (int s) {
+        return s ? 1ULL<<(s-1) : 1;
+    }
+
+    //the slot of bucket b, NULL if its segment isn't allocated yet
+    Bucket* find_slot (uint64_t b) const {
+        int s=segment_of(b);
+        Bucket* segment=_segments[s].load(std::memory_order_acquire);
+        return segment ? &segment[b-segment_start(s)] : NULL;
+    }
+
+    Bucket & slot (uint64_t b) { //can throw bad_alloc
+        int s=segment_of(b);
+        Bucket* segment=_segments[s].load(std::memory_order_acquire);
+        if(!segment) {
+            Bucket* fresh=new Bucket[segment_length(s)](); //all NULL
+            if(_segments[s].compare_exchange_strong(segment, fresh, std::memory_order_acq_rel)) segment=fresh;
+            else delete[] fresh; //another thread allocated it
+        }
+        return segment[b-segment_start(s)];
+    }
+
+    static uint64_t parent (uint64_t b) {
+        return b & ~(1ULL<<floor_log2(b));
+    }
+
+    //the head of bucket b, linked in the chain if it isn't yet. can throw bad_alloc
+    Node* head (uint64_t b) {
+        Bucket & bucket=slot(b);
+        Node* node=bucket.load(std::memory_order_acquire);
+        if(node) return node;
+        Node* from=head(parent(b));
+        uint64_t key=reverse_bits(b);
+        Node* fresh=new Node(key);
+        node=Chain::insert(from, [key](Node* n) { return n->_key<key ? -1 : n->_key>key ? 1 : 0; }, fresh);
+        if(node!=fresh) delete fresh; //another thread linked it
+        bucket.store(node, std::memory_order_release);
+        return node;
+    }
+
+    //the head of bucket b or of its closest linked ancestor
+    Node* linked_head (uint64_t b) const {
+        while(b) {
+            Bucket* bucket=find_slot(b);
+            Node* node = bucket ? bucket->load(std::memory_order_acquire) : NULL;
+            if(node) return node;
+            b=parent(b);
+        }
+        return const_cast<Node*>(&_head);
+    }
+
+    //cmp of the chain for val of hash h : the equal reversed hashes are not sorted, == tells them apart
+    class Cmp {
+        const T & _val;
+        uint64_t _key;
+    public:
+        Cmp (const T & val, uint64_t key) : _val(val), _key(key) {}
+        int operator()(Node* node) const {
+            if(node->_key<_key) return -1;
+            if(node->_key>_key) return 1;
+            return node->data()==_val ? 0 : -1;
+        }
+    };
+
+    static uint64_t key_of (uint64_t h) {
+        return reverse_bits(h)|1;
+    }
+
+public:
+    //buckets : initial number of buckets, rounded up to a power of 2
+    explicit Concurrent_hash_set (uint64_t buckets=16, float max_load=2.0f) :
+            _buckets(1), _size(0), _max_load(max_load), _head(0) {
+        assert(max_load>0);
+        while(_buckets.load()<buckets && _buckets.load()<(1ULL<<(max_segments-1))) _buckets.store(2*_buckets.load());
+        for (int s=0; s<max_segments; s++) _segments[s].store(NULL, std::memory_order_relaxed);
+        slot(0).store(&_head, std::memory_order_relaxed);
+    }
+
+    ~Concurrent_hash_set () {
+        Chain::destroy(&_head);
+        for (int s=0; s<max_segments; s++) delete[] _segments[s].load(std::memory_order_relaxed);
+    }
+
+    Concurrent_hash_set (const Concurrent_hash_set &) = delete;
+    Concurrent_hash_set & operator=(const Concurrent_hash_set &) = delete;
+
+    //false if val is already in the set. can throw bad_alloc, too_many_threads
+    bool insert (const T & val) {
+        if(contains(val)) return false; //no node allocated for nothing
+        return emplace(val);
+    }
+    bool insert (T && val) {
+        return emplace(std::move(val));
+    }
+
+    template <class... Args>
+    bool emplace (Args&&... args) {
+        Epoch_guard guard;
+        Node* node=Node::make(0, std::forward<Args>(args)...);
+        uint64_t h=hash_of(node->data());
+        node->_key=key_of(h);
+        uint64_t buckets=_buckets.load(std::memory_order_acquire);
+        Node* from;
+        try {
+            from=head(h&(buckets-1));
+        }
+        catch(...) {
+            delete node;
+            throw;
+        }
+        if(Chain::insert(from, Cmp(node->data(), node->_key), node)!=node) {
+            delete node; //never linked
+            return false;
+        }
+        long long size=++_size;
+        if(size>buckets*_max_load && buckets<(1ULL<<(max_segments-1)))
+            _buckets.compare_exchange_strong(buckets, 2*buckets);
+        return true;
+    }
+
+    //false if val isn't in the set. can throw bad_alloc, too_many_threads
+    bool erase (const T & val) {
+        Epoch_guard guard;
+        uint64_t h=hash_of(val);
+        Node* from=head(h&(_buckets.load(std::memory_order_acquire)-1));
+        if(!Chain::erase(from, Cmp(val, key_of(h)))) return false;
+        _size--;
+        return true;
+    }
+
+    bool contains (const T & val) const {
+        Epoch_guard guard;
+        uint64_t h=hash_of(val);
+        Node* from=linked_head(h&(_buckets.load(std::memory_order_acquire)-1));
+        return Chain::find(from, Cmp(val, key_of(h)))!=NULL;
+    }
+
+    //copy the element equal to val in out, return false if there is none
+    bool get (const T & val, T & out) const {
+        Epoch_guard guard;
+        uint64_t h=hash_of(val);
+        Node* from=linked_head(h&(_buckets.load(std::memory_order_acquire)-1));
+        Node* node=Chain::find(from, Cmp(val, key_of(h)));
+        if(node) out=node->data();
+        return node!=NULL;
+    }
+
+    template <class F>
+    void for_each (F f) const { //call f(const T &) on each element, in the order of the reversed hashes
+        Epoch_guard guard;
+        auto call=[&f](T & val) { f(static_cast<const T &>(val)); };
+        Chain::for_each(const_cast<Node*>(&_head), call);
+    }
+
+    //the elements inserted minus the ones erased, exact when no change is running
+    long long size () const {
+        return _size.load();
+    }
+
+    uint64_t bucket_count () const {
+        return _buckets.load();
+    }
+};
+#endif /* concurrent_hash_set_hpp */
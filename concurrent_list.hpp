@@ -0,0 +1,270 @@
+//
+//  concurrent_list.hpp
+//  wet2
+//
+//  Lock-free ordered list (Harris, with the unlinking of Michael), shared
+//  by threads without a lock. The nodes are reclaimed by epochs (epoch.hpp).
+//
+
+#ifndef concurrent_list_hpp
+#define concurrent_list_hpp
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <new>
+#include <utility>
+#include "epoch.hpp"
+
+/*
+ A node is deleted in two steps : the low bit of its _next is set (it is
+ logically deleted, no insert can link after it anymore), then it is
+ unlinked from its predecessor by a CAS. Any thread walking the list unlinks
+ the marked nodes it meets, the one whose CAS unlinks a node retires it.
+
+ insert, erase ......  lock-free (CAS, retried when another thread changed
+                       the same link)
+ find ...............  wait-free (one walk, no CAS, no retry)
+
+ Harris_chain has the algorithms on a chain of Harris_node, for any order :
+ cmp(node) is <0 when the node is before the place of the key, 0 when it
+ holds the key, >0 after. The chain starts at a node that is never deleted
+ (the head of Concurrent_list, a bucket of Concurrent_hash_set).
+ */
+template <class T>
+class Harris_node {
+public:
+    std::atomic<uintptr_t> _next; //Harris_node*, the low bit marks this node as deleted
+    uint64_t _key; //odd when the node holds an element (see Concurrent_hash_set), even for a head
+    alignas(T) unsigned char _storage[sizeof(T)];
+
+    explicit Harris_node (uint64_t key) : _next(0), _key(key) {}
+    ~Harris_node () {
+        if(_key&1) data().~T();
+    }
+    T & data () {
+        return *reinterpret_cast<T*>(_storage);
+    }
+
+    //node holding T(args). can throw bad_alloc and whatever the c'tor of T throws
+    template <class... Args>
+    static Harris_node* make (uint64_t key, Args&&... args) {
+        Harris_node* node=new Harris_node(0); //even : no T to destroy yet
+        try {
+            ::new (node->_storage) T(std::forward<Args>(args)...);
+        }
+        catch(...) {
+            delete node;
+            throw;
+        }
+        node->_key=key|1;
+        return node;
+    }
+};
+
+template <class T>
+class Harris_chain {
+public:
+    typedef Harris_node<T> Node;
+
+    static Node* pointer (uintptr_t link) {
+        return reinterpret_cast<Node*>(link&~(uintptr_t)1);
+    }
+    static bool marked (uintptr_t link) {
+        return link&1;
+    }
+
+    static void delete_node (void* node) {
+        delete static_cast<Node*>(node);
+    }
+
+    /*pred and curr around the place of the key, unlinking the marked nodes on
+     the way. return true if curr holds the key. in a guard*/
+    template <class Cmp>
+    static bool search (Node* head, Cmp & cmp, Node*& pred, Node*& curr) {
+    retry:
+        pred=head;
+        curr=pointer(pred->_next.load(std::memory_order_acquire));
+        while(curr) {
+            uintptr_t succ=curr->_next.load(std::memory_order_acquire);
+            if(marked(succ)) {
+                uintptr_t expected=reinterpret_cast<uintptr_t>(curr);
+                if(!pred->_next.compare_exchange_strong(expected, succ&~(uintptr_t)1, std::memory_order_acq_rel))
+                    goto retry; //pred changed or is deleted too
+                Epoch_domain::shared().retire(curr, delete_node);
+                curr=pointer(succ);
+                continue;
+            }
+            int c=cmp(curr);
+            if(c>=0) return c==0;
+            pred=curr;
+            curr=pointer(succ);
+        }
+        return false;
+    }
+
+    /*link node at the place of the key. return it, or the node already
+     holding the key (node is then not linked). in a guard*/
+    template <class Cmp>
+    static Node* insert (Node* head, Cmp cmp, Node* node) {
+        Node* pred;
+        Node* curr;
+        while(true) {
+            if(search(head, cmp, pred, curr)) return curr;
+            node->_next.store(reinterpret_cast<uintptr_t>(curr), std::memory_order_relaxed);
+            uintptr_t expected=reinterpret_cast<uintptr_t>(curr);
+            if(pred->_next.compare_exchange_strong(expected, reinterpret_cast<uintptr_t>(node), std::memory_order_acq_rel))
+                return node;
+        }
+    }
+
+    //mark then unlink the node of the key. return false if there is none. in a guard
+    template <class Cmp>
+    static bool erase (Node* head, Cmp cmp) {
+        Node* pred;
+        Node* curr;
+        while(true) {
+            if(!search(head, cmp, pred, curr)) return false;
+            uintptr_t succ=curr->_next.load(std::memory_order_acquire);
+            if(marked(succ)) continue; //another erase got it first
+            if(!curr->_next.compare_exchange_strong(succ, succ|1, std::memory_order_acq_rel)) continue;
+            uintptr_t expected=reinterpret_cast<uintptr_t>(curr);
+            if(pred->_next.compare_exchange_strong(expected, succ, std::memory_order_acq_rel))
+                Epoch_domain::shared().retire(curr, delete_node);
+            else search(head, cmp, pred, curr); //unlinks it
+            return true;
+        }
+    }
+
+    //the node of the key, NULL if there is none or it is deleted. in a guard
+    template <class Cmp>
+    static Node* find (Node* head, Cmp cmp) {
+        Node* curr=pointer(head->_next.load(std::memory_order_acquire));
+        while(curr) {
+            uintptr_t succ=curr->_next.load(std::memory_order_acquire);
+            int c=cmp(curr);
+            if(c>=0) return c==0 && !marked(succ) ? curr : NULL;
+            curr=pointer(succ);
+        }
+        return NULL;
+    }
+
+    //the first node after head not deleted, NULL if there is none. in a guard
+    static Node* first (Node* head) {
+        Node* curr=pointer(head->_next.load(std::memory_order_acquire));
+        while(curr) {
+            uintptr_t succ=curr->_next.load(std::memory_order_acquire);
+            if(!marked(succ)) return curr;
+            curr=pointer(succ);
+        }
+        return NULL;
+    }
+
+    //f(T &) on the elements not deleted, walking from head. in a guard
+    template <class F>
+    static void for_each (Node* head, F & f) {
+        Node* curr=pointer(head->_next.load(std::memory_order_acquire));
+        while(curr) {
+            uintptr_t succ=curr->_next.load(std::memory_order_acquire);
+            if((curr->_key&1) && !marked(succ)) f(curr->data());
+            curr=pointer(succ);
+        }
+    }
+
+    //delete the chain after head, no thread may use it anymore
+    static void destroy (Node* head) {
+        Node* curr=pointer(head->_next.load(std::memory_order_relaxed));
+        while(curr) {
+            Node* next=pointer(curr->_next.load(std::memory_order_relaxed));
+            delete curr;
+            curr=next;
+        }
+        head->_next.store(0, std::memory_order_relaxed);
+    }
+};
+
+/*needed operators for T : < and ==
+
+ The elements are kept sorted and distinct. Any thread can call any method
+ at any time, but the d'tor. A method returns after its change is visible
+ to all the threads (linearizable), for_each sees a mix of the elements
+ before and after the changes made meanwhile.
+
+ The nodes come from global new/delete : a retired node is deleted later by
+ some thread, maybe after the list is gone, so no memory resource of the
+ list can be used for them.
+ */
+template <class T>
+class Concurrent_list {
+    typedef Harris_chain<T> Chain;
+    typedef typename Chain::Node Node;
+
+    Node _head;
+
+    class Cmp {
+        const T & _val;
+    public:
+        explicit Cmp (const T & val) : _val(val) {}
+        int operator()(Node* node) const {
+            if(node->data()<_val) return -1;
+            return node->data()==_val ? 0 : 1;
+        }
+    };
+
+public:
+    Concurrent_list () : _head(0) {}
+    ~Concurrent_list () {
+        Chain::destroy(&_head);
+    }
+    Concurrent_list (const Concurrent_list &) = delete;
+    Concurrent_list & operator=(const Concurrent_list &) = delete;
+
+    //false if val is already in the list. can throw bad_alloc, too_many_threads
+    bool insert (const T & val) {
+        return emplace(val);
+    }
+    bool insert (T && val) {
+        return emplace(std::move(val));
+    }
+
+    //the element is built (once) before it is linked, from args
+    template <class... Args>
+    bool emplace (Args&&... args) {
+        Epoch_guard guard;
+        Node* node=Node::make(1, std::forward<Args>(args)...);
+        if(Chain::insert(&_head, Cmp(node->data()), node)==node) return true;
+        delete node; //never linked
+        return false;
+    }
+
+    //false if val isn't in the list
+    bool erase (const T & val) {
+        Epoch_guard guard;
+        return Chain::erase(&_head, Cmp(val));
+    }
+
+    bool contains (const T & val) const {
+        Epoch_guard guard;
+        return Chain::find(const_cast<Node*>(&_head), Cmp(val))!=NULL;
+    }
+
+    //copy the element equal to val in out, return false if there is none
+    bool get (const T & val, T & out) const {
+        Epoch_guard guard;
+        Node* node=Chain::find(const_cast<Node*>(&_head), Cmp(val));
+        if(node) out=node->data();
+        return node!=NULL;
+    }
+
+    template <class F>
+    void for_each (F f) const { //call f(const T &) on each element, in order
+        Epoch_guard guard;
+        auto call=[&f](T & val) { f(static_cast<const T &>(val)); };
+        Chain::for_each(const_cast<Node*>(&_head), call);
+    }
+
+    bool is_empty () const {
+        Epoch_guard guard;
+        return !Chain::first(const_cast<Node*>(&_head));
+    }
+};
+#endif /* concurrent_list_hpp */
@@ -0,0 +1,110 @@
+//
+//  container_stats.hpp
+//  wet2
+//
+//  Instrumentation policies of Hash_table, AVL_tree and Min_heap.
+//
+
+#ifndef container_stats_hpp
+#define container_stats_hpp
+#include <stdio.h>
+
+/*
+ The containers take a Stats template parameter, Null_stats by default, and
+ inherit from it (empty base : no space taken). Their hot paths report to it :
+
+ comparisons .......  elements compared with a key : nodes visited by a search
+                      in AVL_tree, == calls of the chain walk of a lookup,
+                      insert or erase in Hash_table, < in the sifts of
+                      Min_heap
+ rotations .........  single rotations of AVL_tree (a double one counts 2)
+ rehashes ..........  rehash of Hash_table (resize, reserve, shrink_to_fit)
+ node_allocations ..  nodes allocated for the elements
+ sift_levels .......  levels an element moved in Min_heap::sift_up/sift_down
+
+ With Null_stats every call is an empty inline function and stats() gives
+ zeros. Counting_stats counts. The containers' stats() return a Container_stats
+ snapshot, Hash_table adds the histogram of its chain lengths to it.
+ */
+class Container_stats {
+public:
+    //chain lengths 0..chain_histogram_size-2, the last entry counts the longer chains
+    static const int chain_histogram_size=17;
+
+    long long _comparisons;
+    long long _rotations;
+    long long _rehashes;
+    long long _node_allocations;
+    long long _sift_levels;
+    long long _chain_lengths[chain_histogram_size];
+    int _max_chain;
+
+    Container_stats () : _comparisons(0), _rotations(0), _rehashes(0), _node_allocations(0), _sift_levels(0), _max_chain(0) {
+        for (int i=0; i<chain_histogram_size; i++) _chain_lengths[i]=0;
+    }
+
+    void add_chain (int length) {
+        _chain_lengths[length<chain_histogram_size-1 ? length : chain_histogram_size-1]++;
+        if(length>_max_chain) _max_chain=length;
+    }
+
+    /*call f(const char* name, long long value) on each counter, to export them
+     (chain_length_<i> for the histogram, chain_length_<n>+ for its last entry)*/
+    template <class F>
+    void for_each_counter (F f) const {
+        f("comparisons", _comparisons);
+        f("rotations", _rotations);
+        f("rehashes", _rehashes);
+        f("node_allocations", _node_allocations);
+        f("sift_levels", _sift_levels);
+        f("max_chain", (long long)_max_chain);
+        char name[32];
+        for (int i=0; i<chain_histogram_size; i++) {
+            snprintf(name, sizeof(name), i<chain_histogram_size-1 ? "chain_length_%d" : "chain_length_%d+", i);
+            f((const char*)name, _chain_lengths[i]);
+        }
+    }
+};
+
+class Null_stats {
+public:
+    static const bool enabled=false;
+    void count_comparisons (long long) const {}
+    void count_rotation () const {}
+    void count_rehash () const {}
+    void count_allocation () const {}
+    void count_sift_levels (long long) const {}
+    Container_stats counters () const {
+        return Container_stats();
+    }
+    void reset_counters () {}
+};
+
+/*the counters are mutable : the const lookups count too*/
+class Counting_stats {
+    mutable Container_stats _counters;
+public:
+    static const bool enabled=true;
+    void count_comparisons (long long n) const {
+        _counters._comparisons+=n;
+    }
+    void count_rotation () const {
+        _counters._rotations++;
+    }
+    void count_rehash () const {
+        _counters._rehashes++;
+    }
+    void count_allocation () const {
+        _counters._node_allocations++;
+    }
+    void count_sift_levels (long long n) const {
+        _counters._sift_levels+=n;
+    }
+    Container_stats counters () const {
+        return _counters;
+    }
+    void reset_counters () {
+        _counters=Container_stats();
+    }
+};
+#endif /* container_stats_hpp */
@@ -0,0 +1,303 @@
+//
+//  dlist.hpp
+//  wet2
+//
+//  Doubly linked version of List : same interface, O(1) work at the tail.
+//
+
+#ifndef dlist_hpp
+#define dlist_hpp
+#include <stdio.h>
+#include <cassert>
+#include <utility>
+#include <type_traits>
+#include "pmr.hpp"
+#include "prefetch.hpp"
+
+/*
+ Circular list around a dummie node, so there is no special case for the
+ first and the last node. Can be used as the bucket type of Hash_table.
+
+ head_insert, tail_insert, emplace_* ....  O(1), allocate a node each
+ delete_last, erase(Node*) ..............  O(1), free the node
+ get_data, erase(val) ...................  O(n)
+ transfer_last, splice ..................  O(1), no allocation
+ unlink, link_head, link_tail ...........  O(1), no allocation
+
+ Every element inserted gets its own node, allocated by the insert. Only
+ the relinking (unlink, link_head, link_tail, splice, transfer_last) goes
+ without allocation : nodes never move once allocated, so a caller can keep
+ a Node* and relink it to another list (or another place of the same list).
+ Lists trading nodes must share the same memory resource.
+ */
+template <class T>
+class Dlist {
+
+public:
+    class Node {
+    public:
+        T _data;
+        Node* _next;
+        Node* _prev;
+        Node() : _next(this), _prev(this) {} //suppose default c'tor for T
+        //build _data in place from args : copy, move or any c'tor of T
+        template <class... Args>
+        explicit Node(Args&&... args) : _data(std::forward<Args>(args)...), _next(this), _prev(this) {}
+    };
+private:
+    std::pmr::memory_resource* _resource;
+    Node* _dummie;
+
+    template <class... Args>
+    Node* make_node (Args&&... args) { //can throw bad_alloc
+        return pmr_new<Node>(_resource, std::forward<Args>(args)...);
+    }
+
+    void destroy_node (Node* node) {
+        pmr_delete(_resource, node);
+    }
+
+    //the node holding val, NULL if there is none
+    Node* find_node (const T & val, long long* compared) const {
+        long long n=0;
+        Node* ptr=_dummie->_next;
+        while(ptr!=_dummie) {
+            n++;
+            if (ptr->_data==val) break;
+            ptr=ptr->_next;
+        }
+        if(compared) *compared+=n;
+        return ptr!=_dummie ? ptr : NULL;
+    }
+
+    //put node between prev and prev->_next
+    static void link_after (Node* prev, Node* node) {
+        node->_prev=prev;
+        node->_next=prev->_next;
+        prev->_next->_prev=node;
+        prev->_next=node;
+    }
+public:
+    //exceptions :
+    class exceptions {};
+    class already_exist : public exceptions {};
+    class dont_exist : public exceptions {};
+    class Empty : public exceptions {};
+    //nodes are allocated from resource, global new/delete by default
+    explicit Dlist (std::pmr::memory_resource* resource=std::pmr::get_default_resource()) : _resource(resource) {
+        _dummie=make_node(); //can throw bad_alloc
+    }
+
+    ~Dlist () {
+        //an arena frees the nodes itself, nothing to destroy in them
+        if(std::is_trivially_destructible<T>::value && pmr_releases_at_once(_resource)) return;
+        Node* ptr=_dummie->_next;
+        while(ptr!=_dummie) {
+            Node* to_destroy=ptr;
+            ptr=ptr->_next;
+            destroy_node(to_destroy);
+        }
+        destroy_node(_dummie);
+    }
+
+    Dlist (const Dlist &) = delete;
+    Dlist & operator=(const Dlist &) = delete;
+
+    Node* head_insert (const T & val) { //can throw bad_alloc
+        return emplace_head(val);
+    }
+
+    Node* head_insert (T && val) { //can throw bad_alloc
+        return emplace_head(std::move(val));
+    }
+
+    template <class... Args>
+    Node* emplace_head (Args&&... args) { //can throw bad_alloc
+        Node* new_node=make_node(std::forward<Args>(args)...);
+        link_after(_dummie, new_node);
+        return new_node;
+    }
+
+    /*don't allow identical objects, can throw bad alloc, can throw already exists,
+     suppose == operator for T*/
+    Node* exclusive_insert (const T & val) {
+        if(contains(val)) throw already_exist();
+        return tail_insert(val);
+    }
+
+    Node* exclusive_insert (T && val) {
+        if(contains(val)) throw already_exist();
+        return tail_insert(std::move(val));
+    }
+
+    /*build the element from args, insert it if it is not already in the list.
+     the node is allocated only after the scan. return false if already exists*/
+    template <class... Args>
+    bool try_emplace (Args&&... args) { //can throw bad_alloc
+        T val(std::forward<Args>(args)...);
+        if(contains(val)) return false;
+        tail_insert(std::move(val));
+        return true;
+    }
+
+    Node* tail_insert (const T & val) { //can throw bad_alloc
+        return emplace_tail(val);
+    }
+
+    Node* tail_insert (T && val) { //can throw bad_alloc
+        return emplace_tail(std::move(val));
+    }
+
+    template <class... Args>
+    Node* emplace_tail (Args&&... args) { //can throw bad_alloc
+        Node* new_node=make_node(std::forward<Args>(args)...);
+        link_after(_dummie->_prev, new_node);
+        return new_node;
+    }
+
+    bool contains (const T & val) const {
+        return get_ptr(val)!=NULL;
+    }
+
+    //take node out of the list it is in, the node is not destroyed
+    static void unlink (Node* node) {
+        assert(node->_next!=node);
+        node->_prev->_next=node->_next;
+        node->_next->_prev=node->_prev;
+        node->_next=node;
+        node->_prev=node;
+    }
+
+    //node must not be in a list (or be unlinked first)
+    void link_head (Node* node) {
+        assert(node->_next==node && node->_prev==node);
+        link_after(_dummie, node);
+    }
+
+    void link_tail (Node* node) {
+        assert(node->_next==node && node->_prev==node);
+        link_after(_dummie->_prev, node);
+    }
+
+    void move_to_head (Node* node) {
+        unlink(node);
+        link_after(_dummie, node);
+    }
+
+    static const bool transfer_allocates=false; //transfer_last relinks the node
+
+    void transfer_last (Dlist & dst_list) { //*this, is the source list, non exclusive
+        assert(_resource==dst_list._resource);
+        if(is_empty()) throw Empty();
+        Node* node_to_tranfer=_dummie->_prev;
+        unlink(node_to_tranfer);
+        dst_list.link_tail(node_to_tranfer);
+    }
+
+    //move all the nodes of src at the tail of *this, src is left empty
+    void splice (Dlist & src) {
+        if(src.is_empty() || &src==this) return;
+        assert(_resource==src._resource);
+        Node* first=src._dummie->_next;
+        Node* last=src._dummie->_prev;
+        src._dummie->_next=src._dummie;
+        src._dummie->_prev=src._dummie;
+
+        first->_prev=_dummie->_prev;
+        _dummie->_prev->_next=first;
+        last->_next=_dummie;
+        _dummie->_prev=last;
+    }
+
+    T & get_data (const T & val) {
+        T* data=get_ptr(val);
+        if(!data) throw dont_exist();
+        return *data;
+    }
+
+    /*same as get_data, but return NULL if val isn't in the list. the number
+     of elements compared with val is added to *compared, if not NULL*/
+    const T* get_ptr (const T & val, long long* compared=NULL) const {
+        const Node* node=find_node(val, compared);
+        return node ? &node->_data : NULL;
+    }
+
+    T* get_ptr (const T & val, long long* compared=NULL) {
+        Node* node=find_node(val, compared);
+        return node ? &node->_data : NULL;
+    }
+
+    template <class F>
+    void for_each (F f) const { //call f(const T &) on each element, in order
+        for (Node* ptr=_dummie->_next; ptr!=_dummie; ptr=ptr->_next) f(ptr->_data);
+    }
+
+    //get_ptr in steps, for Hash_table::find_batch (see List::probe)
+    typedef const Node* Probe;
+
+    void prefetch () const {
+        prefetch_read(_dummie);
+    }
+
+    Probe probe_begin () const {
+        Probe p=_dummie->_next;
+        prefetch_read(p);
+        return p;
+    }
+
+    bool probe (Probe & p, const T & val, const T*& found, long long* compared=NULL) const {
+        if (p!=_dummie && compared) (*compared)++;
+        if (p!=_dummie && !(p->_data==val)) {
+            p=p->_next;
+            if (p!=_dummie) {
+                prefetch_read(p);
+                return false;
+            }
+        }
+        found = p!=_dummie ? &p->_data : NULL;
+        return true;
+    }
+
+    bool is_empty () const {
+        return _dummie->_next==_dummie;
+    }
+
+    Node* first () const { //NULL if empty
+        return is_empty() ? NULL : _dummie->_next;
+    }
+
+    std::pmr::memory_resource* resource () const {
+        return _resource;
+    }
+
+    Node* last () const { //NULL if empty
+        return is_empty() ? NULL : _dummie->_prev;
+    }
+
+    T & get_last () {
+        return _dummie->_prev->_data;
+    }
+
+    void delete_last () {
+        assert(!is_empty());
+        Node* to_destroy=_dummie->_prev;
+        unlink(to_destroy);
+        destroy_node(to_destroy);
+    }
+
+    //destroy node, it must belong to this list
+    void erase (Node* node) {
+        assert(node!=_dummie);
+        unlink(node);
+        destroy_node(node);
+    }
+
+    /*remove the node holding val, can throw dont_exist. suppose == operator for T.
+     compared as in get_ptr*/
+    void erase (const T & val, long long* compared=NULL) {
+        Node* node=find_node(val, compared);
+        if(!node) throw dont_exist();
+        erase(node);
+    }
+};
+#endif /* dlist_hpp */
@@ -0,0 +1,184 @@
+//
+//  epoch.hpp
+//  wet2
+//
+//  Epoch based reclamation of the nodes unlinked from the lock-free
+//  containers (concurrent_list.hpp).
+//
+
+#ifndef epoch_hpp
+#define epoch_hpp
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+/*
+ A node unlinked from a lock-free list can still be read by a thread that
+ got to it before the unlink. So it is retired instead of deleted : kept in
+ the limbo list of the thread that unlinked it, with the global epoch of
+ the moment.
+
+ Each access to the containers is in an Epoch_guard : the thread publishes
+ the epoch it entered at. The global epoch goes from e to e+1 only once
+ every thread inside a guard entered at e. A node retired at e is then
+ deleted when the epoch reaches e+2 : all the threads that could have seen
+ it left their guard.
+
+ A thread staying inside a guard blocks the epoch, and the limbo lists grow
+ until it leaves. A thread that ends with retired nodes hands them to the
+ domain, freed by the next collect of another thread.
+
+ Up to max_threads threads at once use the domain (a slot each, given
+ back when the thread ends).
+ */
+class Epoch_domain {
+public:
+    typedef void (*Deleter)(void*);
+    class too_many_threads {};
+    static const int max_threads=256;
+
+private:
+    class Retired {
+    public:
+        void* _ptr;
+        Deleter _deleter;
+        uint64_t _epoch;
+    };
+
+    class alignas(64) Slot {
+    public:
+        std::atomic<uint64_t> _active; //epoch at the entry in the guard, 0 outside
+        std::atomic<bool> _used;
+        int _nesting;
+        int _retired_since_collect;
+        std::vector<Retired> _limbo; //touched only by the thread of the slot
+        Slot () : _active(0), _used(false), _nesting(0), _retired_since_collect(0) {}
+    };
+
+    //gives the slot back when its thread ends
+    class Thread_slot {
+    public:
+        Slot* _slot;
+        Thread_slot () : _slot(NULL) {}
+        ~Thread_slot () {
+            if(_slot) shared().release(*_slot);
+        }
+    };
+
+    std::atomic<uint64_t> _epoch;
+    Slot _slots[max_threads];
+    std::mutex _orphans_lock;
+    std::vector<Retired> _orphans; //retired by threads that ended
+
+    Epoch_domain () : _epoch(1) {}
+
+    Slot & slot () { //can throw too_many_threads
+        static thread_local Thread_slot thread_slot;
+        if(!thread_slot._slot) thread_slot._slot=&acquire();
+        return *thread_slot._slot;
+    }
+
+    Slot & acquire () {
+        for (int i=0; i<max_threads; i++) {
+            bool expected=false;
+            if(!_slots[i]._used.load(std::memory_order_relaxed) &&
+               _slots[i]._used.compare_exchange_strong(expected, true)) return _slots[i];
+        }
+        throw too_many_threads();
+    }
+
+    void release (Slot & s) {
+        {
+            std::lock_guard<std::mutex> guard(_orphans_lock);
+            _orphans.insert(_orphans.end(), s._limbo.begin(), s._limbo.end());
+        }
+        s._limbo.clear();
+        s._retired_since_collect=0;
+        s._used.store(false, std::memory_order_release);
+    }
+
+    //next epoch if every thread in a guard entered at the current one
+    void try_advance () {
+        uint64_t e=_epoch.load();
+        for (int i=0; i<max_threads; i++) {
+            if(!_slots[i]._used.load()) continue;
+            uint64_t active=_slots[i]._active.load();
+            if(active!=0 && active!=e) return;
+        }
+        _epoch.compare_exchange_strong(e, e+1);
+    }
+
+    //delete what was retired at least 2 epochs ago, keep the rest in list
+    static void free_safe (std::vector<Retired> & list, uint64_t epoch) {
+        size_t kept=0;
+        for (size_t i=0; i<list.size(); i++) {
+            if(list[i]._epoch+2<=epoch) list[i]._deleter(list[i]._ptr);
+            else list[kept++]=list[i];
+        }
+        list.resize(kept);
+    }
+
+public:
+    Epoch_domain (const Epoch_domain &) = delete;
+    Epoch_domain & operator=(const Epoch_domain &) = delete;
+
+    /*the domain of all the lock-free containers. never destroyed : threads
+     (of a static Task_pool...) can end after the static objects*/
+    static Epoch_domain & shared () {
+        static Epoch_domain* domain=new Epoch_domain;
+        return *domain;
+    }
+
+    //guards nest, only the outer one publishes. can throw too_many_threads
+    void enter () {
+        Slot & s=slot();
+        if(s._nesting++) return;
+        s._active.exchange(_epoch.load()); //a full barrier : published before any read of the container
+    }
+
+    void exit () {
+        Slot & s=slot();
+        if(--s._nesting) return;
+        s._active.store(0, std::memory_order_release);
+    }
+
+    /*ptr, unlinked from its container, is deleted by deleter(ptr) once no
+     guard can see it anymore. can throw too_many_threads, bad_alloc (ptr
+     is then never deleted)*/
+    void retire (void* ptr, Deleter deleter) {
+        Slot & s=slot();
+        Retired r;
+        r._ptr=ptr;
+        r._deleter=deleter;
+        r._epoch=_epoch.load();
+        s._limbo.push_back(r);
+        if(++s._retired_since_collect>=64) collect();
+    }
+
+    //try to advance the epoch and delete what is safe to delete, of this thread and the ended ones
+    void collect () {
+        Slot & s=slot();
+        s._retired_since_collect=0;
+        try_advance();
+        uint64_t epoch=_epoch.load();
+        free_safe(s._limbo, epoch);
+        std::unique_lock<std::mutex> guard(_orphans_lock, std::try_to_lock);
+        if(guard.owns_lock()) free_safe(_orphans, epoch);
+    }
+};
+
+//the calling thread is in the domain from the c'tor to the d'tor. can throw too_many_threads
+class Epoch_guard {
+public:
+    Epoch_guard () {
+        Epoch_domain::shared().enter();
+    }
+    ~Epoch_guard () {
+        Epoch_domain::shared().exit();
+    }
+    Epoch_guard (const Epoch_guard &) = delete;
+    Epoch_guard & operator=(const Epoch_guard &) = delete;
+};
+#endif /* epoch_hpp */
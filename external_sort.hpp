@@ -0,0 +1,262 @@
+//
+//  external_sort.hpp
+//  wet2
+//
+//  Sort of files bigger than memory : sorted runs, then a k-way merge on a
+//  Min_heap of the heads of the runs.
+//
+
+#ifndef external_sort_hpp
+#define external_sort_hpp
+#include <stdio.h>
+#include <cassert>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "min_heap.hpp"
+#include "task_pool.hpp"
+
+/*
+ The files are raw arrays of T (T trivially copyable), read and written
+ through buffers of many records : one fread/fwrite per buffer, not per
+ record.
+
+ external_sort (in, out, memory_bytes) :
+   1. run generation : the input is cut in runs of memory_bytes/2, each run
+      is sorted (parallel_sort) and written to a tmpfile by a task while the
+      next run is read in the other half of the memory.
+   2. merge : Kway_merger of up to memory_bytes/merge_buffer_bytes runs at
+      once (several passes above that, a run of runs per pass).
+
+ Kway_merger keeps the head of each run in a Min_heap : each record output
+ costs one replace_min (a sift_down, no Node freed nor allocated) until its
+ run ends.
+
+ T needs a default c'tor. Less is default constructed (std::less, a
+ stateless class). The sort isn't stable. Besides memory_bytes, the runs
+ take disk space in tmpfile()s, about the size of the input.
+ */
+class Run_io_error {}; //fread, fwrite, tmpfile failed, or a partial record at the end of the input
+
+template <class T>
+class Run_reader {
+    FILE* _file;
+    std::vector<T> _buffer;
+    size_t _size;
+    size_t _pos;
+
+    bool fill () {
+        _size=fread(_buffer.data(), sizeof(T), _buffer.size(), _file);
+        _pos=0;
+        if(_size<_buffer.size() && ferror(_file)) throw Run_io_error();
+        return _size!=0;
+    }
+
+public:
+    static_assert(std::is_trivially_copyable<T>::value, "runs are the bytes of T");
+
+    //reads file from where it is, buffer_records at a time. can throw bad_alloc
+    Run_reader (FILE* file, size_t buffer_records) : _file(file), _buffer(buffer_records ? buffer_records : 1), _size(0), _pos(0) {}
+
+    //the next record, NULL at the end of the file. can throw Run_io_error
+    const T* peek () {
+        if(_pos==_size && !fill()) return NULL;
+        return &_buffer[_pos];
+    }
+
+    void pop () {
+        assert(_pos<_size);
+        _pos++;
+    }
+};
+
+template <class T>
+class Run_writer {
+    FILE* _file;
+    std::vector<T> _buffer;
+    size_t _size;
+
+public:
+    static_assert(std::is_trivially_copyable<T>::value, "runs are the bytes of T");
+
+    //can throw bad_alloc
+    Run_writer (FILE* file, size_t buffer_records) : _file(file), _buffer(buffer_records ? buffer_records : 1), _size(0) {}
+
+    void push (const T & val) { //can throw Run_io_error
+        _buffer[_size++]=val;
+        if(_size==_buffer.size()) flush();
+    }
+
+    void flush () { //can throw Run_io_error
+        if(_size && fwrite(_buffer.data(), sizeof(T), _size, _file)!=_size) throw Run_io_error();
+        _size=0;
+    }
+};
+
+template <class T, class Less = std::less<T> >
+class Kway_merger {
+    class Head {
+    public:
+        T _value;
+        int _run;
+        Head (const T & value, int run) : _value(value), _run(run) {}
+        bool operator<(const Head & h) const { //the run breaks the ties : a total order, a stable merge
+            if(Less()(_value, h._value)) return true;
+            if(Less()(h._value, _value)) return false;
+            return _run<h._run;
+        }
+    };
+
+    std::vector<Run_reader<T> > _readers;
+    Min_heap<Head> _heap;
+
+public:
+    //merge the runs, each read from where its file is. can throw Run_io_error, bad_alloc
+    Kway_merger (const std::vector<FILE*> & runs, size_t buffer_records) {
+        _readers.reserve(runs.size());
+        for (size_t r=0; r<runs.size(); r++) _readers.push_back(Run_reader<T>(runs[r], buffer_records));
+        for (size_t r=0; r<runs.size(); r++) {
+            const T* head=_readers[r].peek();
+            if(head) _heap.insert(Head(*head, (int)r));
+        }
+    }
+
+    //the smallest record left, false when all the runs are merged. can throw Run_io_error
+    bool next (T & out) {
+        if(!_heap.size()) return false;
+        const Head & min=_heap.find_min();
+        out=min._value;
+        int run=min._run;
+        _readers[run].pop();
+        const T* head=_readers[run].peek();
+        if(head) _heap.replace_min(Head(*head, run));
+        else _heap.Del_min();
+        return true;
+    }
+};
+
+//the tmpfiles of the runs, closed (so deleted) by the d'tor
+class Run_files {
+public:
+    std::vector<FILE*> _files;
+    Run_files () {}
+    ~Run_files () {
+        for (size_t i=0; i<_files.size(); i++) fclose(_files[i]);
+    }
+    Run_files (const Run_files &) = delete;
+    Run_files & operator=(const Run_files &) = delete;
+    FILE* add () { //can throw Run_io_error, bad_alloc
+        _files.reserve(_files.size()+1);
+        FILE* file=tmpfile();
+        if(!file) throw Run_io_error();
+        _files.push_back(file);
+        return file;
+    }
+    void close (FILE* file) { //a run merged in another one
+        for (size_t i=0; i<_files.size(); i++) {
+            if(_files[i]==file) {
+                fclose(file);
+                _files.erase(_files.begin()+i);
+                return;
+            }
+        }
+    }
+};
+
+//bytes of the buffer of each run in a merge : the number of runs merged at once is memory_bytes/merge_buffer_bytes
+const size_t merge_buffer_bytes=1<<20;
+
+//merge the runs to out, from their beginning. can throw Run_io_error, bad_alloc
+template <class T, class Less>
+void merge_runs (const std::vector<FILE*> & runs, FILE* out, size_t buffer_records) {
+    for (size_t r=0; r<runs.size(); r++) {
+        if(fflush(runs[r])!=0) throw Run_io_error();
+        rewind(runs[r]);
+    }
+    Kway_merger<T, Less> merger(runs, buffer_records);
+    Run_writer<T> writer(out, buffer_records);
+    T val;
+    while(merger.next(val)) writer.push(val);
+    writer.flush();
+}
+
+/*sort the records of in (from where it is to its end) to out, using about
+ memory_bytes of buffers. can throw Run_io_error, bad_alloc*/
+template <class T, class Less = std::less<T> >
+void external_sort (FILE* in, FILE* out, size_t memory_bytes=(size_t)256<<20, Task_pool & pool=Task_pool::shared()) {
+    static_assert(std::is_trivially_copyable<T>::value, "the files are the bytes of T");
+    size_t run_records=memory_bytes/2/sizeof(T);
+    if(run_records<1) run_records=1;
+    Run_files runs;
+
+    //1. runs : read one half while the other is sorted and written
+    std::unique_ptr<T[]> buffers[2]; //default-initialized : no page touched before fread fills it
+    buffers[0].reset(new T[run_records]);
+    buffers[1].reset(new T[run_records]);
+    {
+        Task_group groups[2]={Task_group(pool), Task_group(pool)}; //the task of each half
+        for (int half=0; ; half^=1) {
+            groups[half].wait(); //the run of this half two rounds ago is written
+            size_t bytes=fread(buffers[half].get(), 1, run_records*sizeof(T), in);
+            if(bytes<run_records*sizeof(T) && ferror(in)) throw Run_io_error();
+            if(bytes%sizeof(T)) throw Run_io_error();
+            size_t n=bytes/sizeof(T);
+            if(!n) break;
+            FILE* run=runs.add();
+            T* first=buffers[half].get();
+            groups[half].run([first, n, run, &pool]() {
+                parallel_sort(first, first+n, Less(), pool);
+                if(fwrite(first, sizeof(T), n, run)!=n) throw Run_io_error();
+            });
+            if(n<run_records) break;
+        }
+        groups[0].wait();
+        groups[1].wait();
+    }
+    buffers[0].reset(); //the memory goes to the merge buffers
+    buffers[1].reset();
+
+    //2. merge, in several passes if there are too many runs for the memory
+    size_t fan_in=memory_bytes/merge_buffer_bytes;
+    if(fan_in<2) fan_in=2;
+    while(runs._files.size()>fan_in) {
+        std::vector<FILE*> level=runs._files;
+        for (size_t from=0; from<level.size(); from+=fan_in) {
+            size_t to = from+fan_in<level.size() ? from+fan_in : level.size();
+            std::vector<FILE*> group(level.begin()+from, level.begin()+to);
+            merge_runs<T, Less>(group, runs.add(), merge_buffer_bytes/sizeof(T));
+            for (size_t i=0; i<group.size(); i++) runs.close(group[i]);
+        }
+    }
+    const std::vector<FILE*> & level=runs._files;
+    size_t records=memory_bytes/(level.size()+1)/sizeof(T);
+    if(records<1) records=1;
+    merge_runs<T, Less>(level, out, records);
+    if(fflush(out)!=0) throw Run_io_error();
+}
+
+//the same between two files. can throw Run_io_error, bad_alloc
+template <class T, class Less = std::less<T> >
+void external_sort (const char* in_path, const char* out_path, size_t memory_bytes=(size_t)256<<20,
+                    Task_pool & pool=Task_pool::shared()) {
+    FILE* in=fopen(in_path, "rb");
+    if(!in) throw Run_io_error();
+    FILE* out=fopen(out_path, "wb");
+    if(!out) {
+        fclose(in);
+        throw Run_io_error();
+    }
+    try {
+        external_sort<T, Less>(in, out, memory_bytes, pool);
+    }
+    catch(...) {
+        fclose(in);
+        fclose(out);
+        throw;
+    }
+    fclose(in);
+    if(fclose(out)!=0) throw Run_io_error();
+}
+#endif /* external_sort_hpp */
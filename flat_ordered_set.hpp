@@ -0,0 +1,224 @@
+//
+//  flat_ordered_set.hpp
+//  wet2
+//
+//  Ordered set with the interface of AVL_tree, kept in a sorted array while
+//  it is small.
+//
+
+#ifndef flat_ordered_set_hpp
+#define flat_ordered_set_hpp
+#include <stdio.h>
+#include <cassert>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+#include "AVL_tree.hpp"
+
+/*
+ needed operators for T : <, == and copy c'tor
+
+ Up to Threshold elements, the set is a sorted contiguous array : no node
+ per element, a lookup is a search over adjacent elements. The insert that
+ would go over Threshold moves the elements in an AVL_tree (built in O(n) by
+ build_sorted), a delete that gets the tree under Threshold/2 moves them
+ back in the array (the gap between the two keeps a set living around the
+ threshold from converting again and again).
+
+                       array            tree
+ balanced_insert ....  O(n) moves       O(log n)
+ balanced_delete ....  O(n) moves       O(log n)
+ get ................  O(log n)         O(log n)
+ iteration ..........  O(1) per step    as AVL_tree
+
+ The search in the array is branch free : a linear count of the smaller
+ elements up to 64 elements (the compiler vectorizes it for arithmetic
+ keys), a binary search with conditional moves above.
+
+ Iterators and references are invalidated by the insert/delete that
+ converts, and by any insert/delete while in the array.
+ */
+template <class T, int Threshold=256, class Stats=Null_stats>
+class Flat_ordered_set {
+    typedef AVL_tree<T, Stats> Tree;
+
+    std::pmr::vector<T> _flat;
+    Tree _tree;
+    int _size;
+    bool _in_tree;
+
+    static const int linear_max=64;
+
+    //index of the first element not smaller than val
+    int lower_bound (const T & val) const {
+        const T* a=_flat.data();
+        int n=(int)_flat.size();
+        if(n<=linear_max) {
+            int i=0;
+            for (int k=0; k<n; k++) i+=a[k]<val;
+            return i;
+        }
+        const T* base=a;
+        while(n>1) {
+            int half=n/2;
+            base+=(base[half-1]<val)*half; //no branch to mispredict
+            n-=half;
+        }
+        return (int)(base-a)+(*base<val);
+    }
+
+    T* flat_find (const T & val) const {
+        int i=lower_bound(val);
+        if(i<(int)_flat.size() && _flat[i]==val) return const_cast<T*>(&_flat[i]);
+        return NULL;
+    }
+
+    void to_tree () { //can throw bad_alloc, the set stays in the array
+        _tree.build_sorted(_flat.begin(), (int)_flat.size());
+        _flat.clear();
+        _flat.shrink_to_fit();
+        _in_tree=true;
+    }
+
+    void to_flat () { //can throw bad_alloc, the set stays in the tree
+        _flat.reserve(Threshold);
+        try {
+            for (typename Tree::inorder_iterator it=_tree.in_begin(); it!=_tree.in_end(); ++it)
+                _flat.push_back(it.get_data());
+        }
+        catch(...) {
+            _flat.clear();
+            throw;
+        }
+        _tree.destroy_all();
+        _in_tree=false;
+    }
+
+    template <class U>
+    void insert_value (U && val) {
+        if(_in_tree) {
+            _tree.balanced_insert(std::forward<U>(val));
+            _size++;
+            return;
+        }
+        int i=lower_bound(val);
+        if(i<(int)_flat.size() && _flat[i]==val) throw key_already_exists();
+        if(_size==Threshold) {
+            to_tree();
+            _tree.balanced_insert(std::forward<U>(val));
+        }
+        else _flat.insert(_flat.begin()+i, std::forward<U>(val));
+        _size++;
+    }
+
+public:
+    typedef typename Tree::key_not_found key_not_found;
+    typedef typename Tree::key_already_exists key_already_exists;
+
+    //the array and the nodes are allocated from resource, global new/delete by default
+    explicit Flat_ordered_set (std::pmr::memory_resource* resource=std::pmr::get_default_resource()) :
+            _flat(resource), _tree(NULL, resource), _size(0), _in_tree(false) {}
+    Flat_ordered_set (const Flat_ordered_set &) = delete;
+    Flat_ordered_set & operator=(const Flat_ordered_set &) = delete;
+
+    /*------------------------------iterator----------------------------------*/
+    class inorder_iterator {
+        const T* _ptr; //in the array
+        typename Tree::inorder_iterator _it; //in the tree, when _ptr is NULL
+    public:
+        inorder_iterator (const T* ptr, typename Tree::inorder_iterator it) : _ptr(ptr), _it(it) {}
+        T& get_data () const {
+            return _ptr ? const_cast<T&>(*_ptr) : _it.get_data();
+        }
+        inorder_iterator & operator++() {
+            if(_ptr) _ptr++;
+            else ++_it;
+            return *this;
+        }
+        bool operator==(const inorder_iterator & i) const {
+            return _ptr==i._ptr && _it==i._it;
+        }
+        bool operator!=(const inorder_iterator & i) const {
+            return !(*this==i);
+        }
+    };
+
+    inorder_iterator in_begin () const {
+        if(_in_tree) return inorder_iterator(NULL, _tree.in_begin());
+        return inorder_iterator(_flat.data(), _tree.in_end());
+    }
+    inorder_iterator in_end () const {
+        if(_in_tree) return inorder_iterator(NULL, _tree.in_end());
+        return inorder_iterator(_flat.data()+_flat.size(), _tree.in_end());
+    }
+
+    /*-------------------------------methods----------------------------------*/
+    //can throw key_already_exists, std::bad_alloc
+    void balanced_insert (const T & val) {
+        insert_value(val);
+    }
+    void balanced_insert (T && val) {
+        insert_value(std::move(val));
+    }
+
+    template <class... Args>
+    void emplace (Args&&... args) { //can throw key_already_exists, std::bad_alloc
+        insert_value(T(std::forward<Args>(args)...));
+    }
+
+    template <class... Args>
+    bool try_emplace (Args&&... args) { //can throw std::bad_alloc
+        T val(std::forward<Args>(args)...);
+        if(get_ptr(val)) return false;
+        insert_value(std::move(val));
+        return true;
+    }
+
+    //can throw key_not_found
+    void balanced_delete (const T & val) {
+        if(_in_tree) {
+            _tree.balanced_delete(val);
+            _size--;
+            if(_size<Threshold/2) {
+                try {
+                    to_flat();
+                }
+                catch(std::bad_alloc &) {} //the element is deleted, the set stays a tree
+            }
+            return;
+        }
+        T* p=flat_find(val);
+        if(!p) throw key_not_found();
+        _flat.erase(_flat.begin()+(p-_flat.data()));
+        _size--;
+    }
+
+    T& get (const T & val) const { //can throw key_not_found
+        T* p=get_ptr(val);
+        if(!p) throw key_not_found();
+        return *p;
+    }
+
+    //same as get, but return NULL if val isn't in the set
+    T* get_ptr (const T & val) const {
+        return _in_tree ? _tree.get_ptr(val) : flat_find(val);
+    }
+
+    bool contains (const T & val) const {
+        return get_ptr(val)!=NULL;
+    }
+
+    int size () const {
+        return _size;
+    }
+
+    bool is_empty () const {
+        return _size==0;
+    }
+
+    //true once the set went over Threshold (and not back under Threshold/2)
+    bool is_tree () const {
+        return _in_tree;
+    }
+};
+#endif /* flat_ordered_set_hpp */
@@ -0,0 +1,353 @@
+//
+//  frozen_hash_table.hpp
+//  wet2
+//
+//  Read only table indexed by a minimal perfect hash, built from a Hash_table.
+//
+
+#ifndef frozen_hash_table_hpp
+#define frozen_hash_table_hpp
+#include <stdio.h>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "hash_table.hpp"
+#include "snapshot.hpp"
+
+/*
+ freeze(t) copies the n elements of a Hash_table in an array of exactly n
+ slots, placed by a minimal perfect hash (PTHash style) : a lookup is one
+ slot probe and one compare with ==, never a chain walk.
+
+ The keys are split in buckets of 4 on average. Each bucket gets a 16 bits
+ pilot, chosen at build time so that the keys of the bucket land in free
+ positions (h^mix(pilot)) % m. m is n/0.98 so the last buckets still find
+ free positions fast; the keys landing past n are sent to the free slots
+ under n by a small remap array. That is about 4.7 bits per key over the
+ elements themselves.
+
+ find, find_ptr ..........  O(1), one slot probe
+ freeze ..................  O(n) expected
+ save, map ...............  O(n) (T trivially copyable)
+
+ map checks the file before any lookup : the sizes in the header against
+ the file length, the remap entries against n, and the snapshot_checksum
+ (snapshot.hpp) of the header and of each section. The file is read once
+ for that, then used in place, no copy. A truncated or damaged file throws
+ io_error.
+
+ Two elements with the same int hash can't be told apart by any perfect hash :
+ freeze throws hash_collision.
+ */
+
+template <class T, class Hash = Key_hash<T> >
+class Frozen_hash_table {
+    enum { KEYS_PER_BUCKET=4, MAX_PILOT=65536, MAX_SEEDS=64 };
+
+    class Header { //file layout : Header, pilots, remap, slots (each at a multiple of 64)
+    public:
+        char _magic[8];
+        uint64_t _elem_size;
+        uint64_t _n;
+        uint64_t _m;
+        uint64_t _buckets;
+        uint64_t _seed;
+        uint64_t _checksums[3]; //of the pilots, the remap, the slots
+        uint64_t _header_checksum; //of the header, with this field at 0
+    };
+
+    static void file_magic (char* magic) {
+        memcpy(magic, "FROZEN2", 8);
+    }
+
+    static uint64_t header_checksum (Header header) {
+        header._header_checksum=0;
+        return snapshot_checksum(&header, sizeof(header));
+    }
+
+    uint64_t _n; //elements
+    uint64_t _m; //positions, >= n
+    uint64_t _buckets;
+    uint64_t _seed;
+    const uint16_t* _pilots;
+    const uint32_t* _remap; //position-n -> free slot, for positions >= n
+    T* _slots;
+    void* _mapping; //the file when mapped, NULL when built in memory
+    size_t _mapping_len;
+
+    uint64_t hash (const T & val) const {
+        return mix_hash((uint64_t)(uint32_t)Hash()(val)^_seed);
+    }
+    uint64_t bucket (uint64_t h) const {
+        return (h>>32)%_buckets;
+    }
+    uint64_t position (uint64_t h, uint16_t pilot) const {
+        return (h^mix_hash(pilot))%_m;
+    }
+    uint64_t slot (uint64_t h) const {
+        uint64_t p=position(h, _pilots[bucket(h)]);
+        return p<_n ? p : _remap[p-_n];
+    }
+
+    static size_t align (size_t offset) {
+        return (offset+63)&~(size_t)63;
+    }
+
+    void release () {
+        if(_mapping) munmap(_mapping, _mapping_len);
+        else {
+            delete [] _pilots;
+            delete [] _remap;
+            delete [] _slots;
+        }
+        _pilots=NULL;
+        _remap=NULL;
+        _slots=NULL;
+        _mapping=NULL;
+        _n=0;
+    }
+
+    //look for the pilots with the current seed. return false if a bucket has none
+    bool place (const std::vector<uint64_t> & hashes, std::vector<uint16_t> & pilots,
+                std::vector<uint64_t> & positions) const {
+        std::vector<uint64_t> first(_buckets+1, 0); //keys of bucket b : order[first[b]..first[b+1]]
+        for (size_t i=0; i<hashes.size(); i++) first[bucket(hashes[i])+1]++;
+        for (uint64_t b=0; b<_buckets; b++) first[b+1]+=first[b];
+        std::vector<uint64_t> order(hashes.size());
+        std::vector<uint64_t> fill(first.begin(), first.end()-1);
+        for (size_t i=0; i<hashes.size(); i++) order[fill[bucket(hashes[i])]++]=i;
+
+        std::vector<uint64_t> by_size(_buckets); //the biggest buckets first
+        for (uint64_t b=0; b<_buckets; b++) by_size[b]=b;
+        std::stable_sort(by_size.begin(), by_size.end(), [&first](uint64_t a, uint64_t b) {
+            return first[a+1]-first[a]>first[b+1]-first[b];
+        });
+
+        std::vector<bool> taken(_m, false);
+        std::vector<uint64_t> tried;
+        for (uint64_t k=0; k<_buckets; k++) {
+            uint64_t b=by_size[k];
+            if(first[b]==first[b+1]) break;
+            uint32_t pilot;
+            for (pilot=0; pilot<MAX_PILOT; pilot++) {
+                tried.clear();
+                uint64_t i;
+                for (i=first[b]; i<first[b+1]; i++) {
+                    uint64_t p=position(hashes[order[i]], (uint16_t)pilot);
+                    if(taken[p] || std::find(tried.begin(), tried.end(), p)!=tried.end()) break;
+                    tried.push_back(p);
+                }
+                if(i==first[b+1]) break;
+            }
+            if(pilot==MAX_PILOT) return false;
+            pilots[b]=(uint16_t)pilot;
+            for (uint64_t i=first[b]; i<first[b+1]; i++) {
+                positions[order[i]]=tried[i-first[b]];
+                taken[tried[i-first[b]]]=true;
+            }
+        }
+        return true;
+    }
+
+public:
+    class exception {};
+    class dont_exist : public exception {};
+    class hash_collision : public exception {};
+    class build_failed : public exception {};
+    class io_error : public exception {};
+
+    Frozen_hash_table () : _n(0), _m(1), _buckets(1), _seed(0), _pilots(NULL), _remap(NULL),
+            _slots(NULL), _mapping(NULL), _mapping_len(0) {}
+
+    //build from n elements, == must tell them all apart. can throw bad_alloc,
+    //hash_collision, build_failed
+    Frozen_hash_table (const T* elements, uint64_t n) : Frozen_hash_table() {
+        if(!n) return;
+        _m=n+n/50+1;
+        _buckets=(n+KEYS_PER_BUCKET-1)/KEYS_PER_BUCKET;
+        std::vector<uint64_t> hashes(n);
+        std::vector<uint16_t> pilots(_buckets);
+        std::vector<uint64_t> positions(n);
+
+        std::vector<uint32_t> base(n); //the int hashes must differ
+        for (uint64_t i=0; i<n; i++) base[i]=(uint32_t)Hash()(elements[i]);
+        std::sort(base.begin(), base.end());
+        if(std::adjacent_find(base.begin(), base.end())!=base.end()) throw hash_collision();
+
+        int attempt;
+        for (attempt=0; attempt<MAX_SEEDS; attempt++) {
+            _seed=mix_hash(attempt+1);
+            for (uint64_t i=0; i<n; i++) hashes[i]=hash(elements[i]);
+            if(place(hashes, pilots, positions)) break;
+        }
+        if(attempt==MAX_SEEDS) throw build_failed();
+
+        std::vector<bool> used(n, false);
+        for (uint64_t i=0; i<n; i++) if(positions[i]<n) used[positions[i]]=true;
+        uint16_t* pilots_array=new uint16_t[_buckets];
+        uint32_t* remap=NULL;
+        T* slots=NULL;
+        try {
+            remap=new uint32_t[_m-n];
+            slots=new T[n];
+        }
+        catch(std::bad_alloc &) {
+            delete [] pilots_array;
+            delete [] remap;
+            throw;
+        }
+        std::copy(pilots.begin(), pilots.end(), pilots_array);
+        uint64_t free_slot=0;
+        for (uint64_t p=0; p<_m-n; p++) remap[p]=0;
+        for (uint64_t i=0; i<n; i++) {
+            if(positions[i]<n) continue;
+            while(used[free_slot]) free_slot++;
+            used[free_slot]=true;
+            remap[positions[i]-n]=(uint32_t)free_slot;
+        }
+        _pilots=pilots_array;
+        _remap=remap;
+        _slots=slots;
+        _n=n;
+        for (uint64_t i=0; i<n; i++) _slots[slot(hashes[i])]=elements[i];
+    }
+
+    ~Frozen_hash_table () {
+        release();
+    }
+    Frozen_hash_table (const Frozen_hash_table &) = delete;
+    Frozen_hash_table & operator=(const Frozen_hash_table &) = delete;
+    Frozen_hash_table (Frozen_hash_table && t) : Frozen_hash_table() {
+        *this=std::move(t);
+    }
+    Frozen_hash_table & operator=(Frozen_hash_table && t) {
+        if(this==&t) return *this;
+        release();
+        _n=t._n; _m=t._m; _buckets=t._buckets; _seed=t._seed;
+        _pilots=t._pilots; _remap=t._remap; _slots=t._slots;
+        _mapping=t._mapping; _mapping_len=t._mapping_len;
+        t._pilots=NULL; t._remap=NULL; t._slots=NULL; t._mapping=NULL; t._n=0;
+        return *this;
+    }
+
+    const T* find_ptr (const T & val) const {
+        if(!_n) return NULL;
+        const T & candidate=_slots[slot(hash(val))];
+        return candidate==val ? &candidate : NULL;
+    }
+
+    const T & find (const T & val) const { //can throw dont_exist
+        const T* found=find_ptr(val);
+        if(!found) throw dont_exist();
+        return *found;
+    }
+
+    uint64_t size () const {
+        return _n;
+    }
+
+    //bytes besides the elements : pilots and remap
+    size_t index_bytes () const {
+        return _n ? sizeof(uint16_t)*_buckets+sizeof(uint32_t)*(_m-_n) : 0;
+    }
+
+    /*write the table to path, to be mapped back by map. can throw io_error*/
+    void save (const char* path) const {
+        static_assert(std::is_trivially_copyable<T>::value, "save needs a trivially copyable T");
+        Header header;
+        memset(&header, 0, sizeof(header));
+        file_magic(header._magic);
+        header._elem_size=sizeof(T);
+        header._n=_n;
+        header._m=_m;
+        header._buckets=_buckets;
+        header._seed=_seed;
+        const void* parts[3]={_pilots, _remap, _slots};
+        size_t sizes[3]={_n ? sizeof(uint16_t)*_buckets : 0, _n ? sizeof(uint32_t)*(_m-_n) : 0, sizeof(T)*_n};
+        for (int i=0; i<3; i++) header._checksums[i]=snapshot_checksum(parts[i], sizes[i]);
+        header._header_checksum=header_checksum(header);
+        FILE* file=fopen(path, "wb");
+        if(!file) throw io_error();
+        static const char zeros[64]={0};
+        size_t offset=0;
+        bool ok=fwrite(&header, sizeof(header), 1, file)==1;
+        offset+=sizeof(header);
+        for (int i=0; i<3 && ok; i++) {
+            ok=fwrite(zeros, 1, align(offset)-offset, file)==align(offset)-offset;
+            offset=align(offset);
+            ok=ok && (!sizes[i] || fwrite(parts[i], 1, sizes[i], file)==sizes[i]);
+            offset+=sizes[i];
+        }
+        if(fclose(file)!=0 || !ok) throw io_error();
+    }
+
+    /*map a file written by save, read only and checked (see above) : no copy,
+     the lookups read the file in place. can throw io_error*/
+    static Frozen_hash_table map (const char* path) {
+        static_assert(std::is_trivially_copyable<T>::value, "map needs a trivially copyable T");
+        int fd=open(path, O_RDONLY);
+        if(fd<0) throw io_error();
+        struct stat st;
+        if(fstat(fd, &st)!=0 || (size_t)st.st_size<sizeof(Header)) {
+            close(fd);
+            throw io_error();
+        }
+        void* base=mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if(base==MAP_FAILED) throw io_error();
+
+        Frozen_hash_table t;
+        t._mapping=base; //unmapped by t if a check throws
+        t._mapping_len=st.st_size;
+        Header header;
+        memcpy(&header, base, sizeof(header));
+        char magic[8];
+        file_magic(magic);
+        if(memcmp(header._magic, magic, 8)!=0 || header._elem_size!=sizeof(T) ||
+           header._header_checksum!=header_checksum(header)) throw io_error();
+        uint64_t n=header._n;
+        if(n && (header._buckets==0 || n>header._m || n>UINT32_MAX)) throw io_error(); //slots are indexed by uint32
+        uint64_t counts[3]={n ? header._buckets : 0, n ? header._m-n : 0, n};
+        size_t elem_sizes[3]={sizeof(uint16_t), sizeof(uint32_t), sizeof(T)};
+        const char* parts[3];
+        size_t len=st.st_size;
+        size_t offset=sizeof(Header);
+        for (int i=0; i<3; i++) {
+            offset=align(offset);
+            if(offset>len || counts[i]>(len-offset)/elem_sizes[i]) throw io_error(); //doesn't fit, no overflow
+            parts[i]=(const char*)base+offset;
+            offset+=counts[i]*elem_sizes[i];
+            if(snapshot_checksum(parts[i], counts[i]*elem_sizes[i])!=header._checksums[i]) throw io_error();
+        }
+        const uint32_t* remap=(const uint32_t*)parts[1];
+        for (uint64_t p=0; p<counts[1]; p++)
+            if(remap[p]>=n) throw io_error();
+        t._m = n ? header._m : 1;
+        t._buckets = n ? header._buckets : 1;
+        t._seed=header._seed;
+        t._pilots=(const uint16_t*)parts[0];
+        t._remap=remap;
+        t._slots=(T*)parts[2];
+        t._n=n;
+        return t;
+    }
+};
+
+/*the elements of t in a Frozen_hash_table. can throw bad_alloc, hash_collision, build_failed*/
+template <class T, class Bucket, class Stats>
+Frozen_hash_table<T> freeze (const Hash_table<T, Bucket, Stats> & t) {
+    std::vector<T> elements;
+    elements.reserve(t.size());
+    t.for_each([&elements](const T & val) { elements.push_back(val); });
+    return Frozen_hash_table<T>(elements.data(), elements.size());
+}
+#endif /* frozen_hash_table_hpp */
@@ -10,13 +10,94 @@
 #define hash_table_hpp
 #include <stdio.h>
 #include <cassert>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <functional>
+#include <new>
+#include <atomic>
+#include <vector>
 #include "list.hpp"
+#include "task_pool.hpp"
+#include "pmr.hpp"
+#include "container_stats.hpp"
+#include "snapshot.hpp"
+#include "prefetch.hpp"
 
-template <class T>
-class Hash_table {
+/*hash for the keys of the containers built over Hash_table (Indexed_min_heap...).
+ integral keys hash to themselves (dense ids stay dense), other keys suppose
+ operator () like the elements of Hash_table. always return a non negative int*/
+template <class K, bool = std::is_integral<K>::value>
+class Key_hash {
+public:
+    constexpr int operator()(const K & key) const {
+        return key.operator()();
+    }
+};
+
+template <class K>
+class Key_hash<K, true> {
+public:
+    constexpr int operator()(const K & key) const {
+        unsigned long long k=(unsigned long long)key;
+        return (int)((k^(k>>31))&0x7fffffff);
+    }
+};
+
+/*spread an int hash on 64 bits (splitmix64 finalizer), for the structures
+ that need more bits than the int of Key_hash (filters, perfect hash...)*/
+inline uint64_t mix_hash (uint64_t x) {
+    x+=0x9e3779b97f4a7c15ULL;
+    x=(x^(x>>30))*0xbf58476d1ce4e5b9ULL;
+    x=(x^(x>>27))*0x94d049bb133111ebULL;
+    return x^(x>>31);
+}
+
+/*Bucket is the type of the chains : List<T> (default), Dlist<T> or
+ Unrolled_list<T>, any class with the interface of List. Bucket::transfer_allocates
+ tells how rehash moves the elements : false, transfer_last relinks them
+ one by one (List, Dlist) ; true, they are copied to the new buckets and the
+ old ones freed after (Unrolled_list), so a bad_alloc leaves the table as it
+ was either way.
+
+ load factor = elements / buckets. The table grows when an insert would go
+ over max_load, and shrinks when an erase gets under min_load (never under
+ the initial number of buckets, nor under the ones asked by reserve). Both
+ resize to a load of max_load/2, and min_load must stay under max_load/2 :
+ after a resize the number of elements has to double or halve before the
+ next one, so insert/erase churn around a threshold doesn't resize again and
+ again.
+
+ The bucket array and the nodes of the buckets come from the memory resource
+ given to the c'tor (global new/delete by default) : Bucket needs a c'tor
+ taking a std::pmr::memory_resource*.
+
+ Stats is the instrumentation policy (see container_stats.hpp) : Null_stats
+ or Counting_stats.
+
+ save/load (T trivially copyable) write the table as a snapshot (see
+ snapshot.hpp) : the number of buckets, the load factors, then bucket after
+ bucket each element with its hash code. load allocates the buckets once and
+ appends each element to its chain, in the saved order : no resize, no
+ rehash, no operator () and no compare.*/
+template <class T, class Bucket = List<T>, class Stats = Null_stats>
+class Hash_table : private Stats {
     int _size;
     int _insertions_num;
-    List<T>* _array;
+    int _min_size;
+    int _reserved; //buckets asked by reserve, the table doesn't shrink under them
+    float _max_load;
+    float _min_load;
+    std::pmr::memory_resource* _resource;
+    Bucket* _array;
+    
+    Bucket* new_buckets (int n) { //can throw bad alloc;
+        return n ? pmr_new_array<Bucket>(_resource, n, _resource) : NULL;
+    }
+    
+    void delete_buckets (Bucket* array, int n) {
+        pmr_delete_array(_resource, array, n);
+    }
     
     class Func {
     public:
@@ -27,69 +108,497 @@ class Hash_table {
     };
     
     Func _f;
+    
+    //where the bucket walks add the elements they compare, NULL when Stats doesn't count
+    static long long* compared_in (long long & compared) {
+        return Stats::enabled ? &compared : NULL;
+    }
+    
+    //V is const T & or T : the bucket copies or moves val in the node
+    template <class V>
+    void quick_insert_value (V && val) {
+        assert(_insertions_num<=_size);
+        int i=(_f)(val,_size);
+        assert(i>=0 && i<_size);
+        _array[i].head_insert(std::forward<V>(val)); //can throw bad alloc;
+        Stats::count_allocation();
+        _insertions_num++;
+    }
+    
+    //val is looked for first, a duplicate is never copied nor moved
+    template <class V>
+    void insert_value (V && val) { //can throw bad alloc, already_exist;
+        if (_insertions_num+1>_size*_max_load) resize();
+        
+        int i=(_f)(val,_size);
+        assert(i>=0 && i<_size);
+        long long compared=0;
+        bool exists=static_cast<const Bucket &>(_array[i]).get_ptr(val, compared_in(compared))!=NULL;
+        Stats::count_comparisons(compared);
+        if (exists) throw already_exist();
+        _array[i].tail_insert(std::forward<V>(val)); //can throw bad alloc;
+        Stats::count_allocation();
+        _insertions_num++;
+    }
 public :
     class exception {};
     class already_exist : public exception {};
     class dont_exist : public exception {};
-    Hash_table (int size=10) : _size(size), _insertions_num(0) {
-        if(size)
-            _array=new List<T>[size];
+    Hash_table (int size=10, float max_load=1.0f, float min_load=0.25f,
+                std::pmr::memory_resource* resource=std::pmr::get_default_resource()) :
+            _size(size), _insertions_num(0), _min_size(size), _reserved(0), _max_load(max_load), _min_load(min_load), _resource(resource) {
+        assert(max_load>0 && min_load>=0 && 2*min_load<max_load);
+        _array=new_buckets(size);
     }
     
     ~Hash_table () {
-        delete [] _array;
+        //an arena frees the array and the nodes itself, nothing to destroy in them
+        if (std::is_trivially_destructible<T>::value && pmr_releases_at_once(_resource)) return;
+        delete_buckets(_array, _size);
     }
     
     void quick_insert (const T & val) { //suppose that there is enough place, hence _size>_insertion_num
-        assert(_insertions_num<=_size);
-        int i=(_f)(val,_size);
-        assert(i>=0 && i<_size);
-        _array[i].List<T>::head_insert(val); //can throw bad alloc;
-        _insertions_num++;
+        quick_insert_value(val);
     }
     
-    void resize () { //can throw bad alloc;
-        List<T>* new_array=new List<T>[_insertions_num*2+2];
-        int i;
-        for (i=0; i<_size; i++) {
-            while (1) {
-                try {
-                    int index=_f.operator()(_array[i].List<T>::get_last(), _insertions_num*2+2);
-                    _array[i].List<T>::transfer_last( new_array[index] );
-                }
-                catch(typename List<T>::Empty &) {
-                    break;
+    void quick_insert (T && val) {
+        quick_insert_value(std::move(val));
+    }
+    
+    /*move all the elements to a new array of new_size buckets. can throw bad
+     alloc; the table is then unchanged*/
+    void rehash (int new_size) {
+        assert(new_size>0);
+        Bucket* new_array=new_buckets(new_size);
+        Stats::count_rehash();
+        if constexpr (Bucket::transfer_allocates) {
+            //copy to the new array, the old one goes only once the new one is complete
+            try {
+                for_each([this, new_array, new_size](const T & val) {
+                    new_array[_f(val, new_size)].tail_insert(val); //can throw bad alloc;
+                });
+            }
+            catch(...) {
+                delete_buckets(new_array, new_size);
+                throw;
+            }
+        }
+        else {
+            int i;
+            for (i=0; i<_size; i++) {
+                while (!_array[i].is_empty()) {
+                    int index=_f.operator()(_array[i].get_last(), new_size);
+                    _array[i].transfer_last( new_array[index] ); //relinks, no allocation
                 }
             }
         }
-        delete [] _array;
+        delete_buckets(_array, _size);
         _array=new_array;
-        _size=_insertions_num*2+2;
-        
+        _size=new_size;
+    }
+    
+    //the least number of buckets : the initial one, or more after reserve
+    int floor_size () const {
+        return _reserved>_min_size ? _reserved : _min_size;
+    }
+    
+    void resize () { //can throw bad alloc;
+        int new_size=(int)(_insertions_num*2/_max_load)+2;
+        if (new_size<floor_size()) new_size=floor_size();
+        if (new_size!=_size) rehash(new_size);
+    }
+    
+    //grow to hold n elements under max_load, without keeping the size. can throw bad alloc;
+    void make_room (int n) {
+        if (n>_size*_max_load) rehash((int)(n/_max_load)+1);
+    }
+    
+    /*make room for n elements without resize : the erases don't shrink the
+     table under it either, until shrink_to_fit or clear. can throw bad alloc;*/
+    void reserve (int n) {
+        make_room(n);
+        int buckets=(int)(n/_max_load)+1;
+        if (buckets>_reserved) _reserved=buckets;
+    }
+    
+    //the least buckets holding the elements under max_load, forgets reserve. can throw bad alloc;
+    void shrink_to_fit () {
+        int new_size=(int)(_insertions_num/_max_load)+1;
+        if (new_size<_size) rehash(new_size);
+        _reserved=0;
+    }
+    
+    //destroy all the elements, keep the number of buckets, forgets reserve. can throw bad alloc;
+    void clear () {
+        Bucket* new_array=new_buckets(_size);
+        delete_buckets(_array, _size);
+        _array=new_array;
+        _insertions_num=0;
+        _reserved=0;
+    }
+    
+    //min_load must be under max_load/2. can throw bad alloc;
+    void set_load_factors (float max_load, float min_load) {
+        assert(max_load>0 && min_load>=0 && 2*min_load<max_load);
+        _max_load=max_load;
+        _min_load=min_load;
+        if (_insertions_num>_size*_max_load) resize();
+    }
+    
+    float max_load_factor () const {
+        return _max_load;
+    }
+    
+    float min_load_factor () const {
+        return _min_load;
+    }
+    
+    float load_factor () const {
+        return _size ? (float)_insertions_num/_size : 0;
+    }
+    
+    std::pmr::memory_resource* resource () const {
+        return _resource;
+    }
+    
+    int bucket_count () const {
+        return _size;
     }
     
     void insert (const T & val) { //can throw bad alloc, already_exist;
-        if (_insertions_num+1>_size) resize();
-        
-        assert(_insertions_num<_size);
+        insert_value(val);
+    }
+    
+    void insert (T && val) { //can throw bad alloc, already_exist;
+        insert_value(std::move(val));
+    }
+    
+    //build the element from args (needed to hash it) and move it in its bucket
+    template <class... Args>
+    void emplace (Args&&... args) { //can throw bad alloc, already_exist;
+        insert(T(std::forward<Args>(args)...));
+    }
+    
+    //as emplace, but return false instead of throwing already_exist
+    template <class... Args>
+    bool try_emplace (Args&&... args) { //can throw bad alloc
+        T val(std::forward<Args>(args)...);
+        if (_insertions_num+1>_size*_max_load) resize();
         int i=(_f)(val,_size);
         assert(i>=0 && i<_size);
+        long long compared=0;
+        bool exists=static_cast<const Bucket &>(_array[i]).get_ptr(val, compared_in(compared))!=NULL;
+        Stats::count_comparisons(compared);
+        if (exists) return false;
+        _array[i].tail_insert(std::move(val)); //can throw bad alloc;
+        Stats::count_allocation();
+        _insertions_num++;
+        return true;
+    }
+    
+    void erase (const T & val) { //can throw dont_exist
+        if (!_size) throw dont_exist();
+        int i=(_f)(val,_size);
+        long long compared=0;
         try {
-            _array[i].List<T>::exclusive_insert(val); //can throw bad alloc;
+            _array[i].erase(val, compared_in(compared));
+        }
+        catch(typename Bucket::dont_exist &) {
+            Stats::count_comparisons(compared);
+            throw dont_exist();
         }
-        catch(typename List<T>::already_exist &) {
-            throw already_exist();
+        Stats::count_comparisons(compared);
+        _insertions_num--;
+        if (_size>floor_size() && _insertions_num<_size*_min_load) {
+            try {
+                resize();
+            }
+            catch(std::bad_alloc &) {} //the element is erased, rehash left the table as it was
         }
-        _insertions_num++;
+    }
+    
+    int size () const {
+        return _insertions_num;
+    }
+    
+    template <class F>
+    void for_each (F f) const { //call f(const T &) on each element, bucket after bucket
+        for (int i=0; i<_size; i++) _array[i].for_each(std::ref(f));
+    }
+    
+    /*as for_each, but ranges of buckets in parallel : f is called from several
+     threads at once, in no particular order*/
+    template <class F>
+    void parallel_for_each (F f, Task_pool & pool=Task_pool::shared()) const {
+        parallel_ranges(0, _size, [this, &f](long long from, long long to) {
+            for (long long i=from; i<to; i++) _array[i].for_each(std::ref(f));
+        }, pool);
+    }
+    
+    /*insert the n elements of first, in parallel. the elements are grouped by
+     range of buckets (the hashes are computed in parallel), then one task
+     fills each range : no bucket is touched by two tasks. return the number
+     of elements inserted, the duplicates are skipped. can throw bad alloc;
+     the tasks allocate nodes only from a thread safe resource (see
+     pmr_thread_safe), with any other resource a single task fills the
+     buckets. Stats doesn't count in here.*/
+    int parallel_insert (const T* first, int n, Task_pool & pool=Task_pool::shared()) {
+        if (n<=0) return 0;
+        make_room(_insertions_num+n);
+        int chunks=4*pool.threads_num();
+        if (chunks>n) chunks=n;
+        int ranges = pmr_thread_safe(_resource) ? 4*pool.threads_num() : 1;
+        if (ranges>_size) ranges=_size;
+        std::vector<int> bucket(n);
+        std::vector<int> offsets((size_t)chunks*ranges, 0); //elements of chunk c in range r, then where they go
+        
+        Task_group group(pool);
+        for (int c=0; c<chunks; c++) {
+            group.run([&, c]() {
+                for (int k=(int)((long long)n*c/chunks); k<(long long)n*(c+1)/chunks; k++) {
+                    bucket[k]=Func()(first[k], _size);
+                    offsets[(size_t)c*ranges+(long long)bucket[k]*ranges/_size]++;
+                }
+            });
+        }
+        group.wait();
+        std::vector<int> range_start(ranges+1);
+        int position=0;
+        for (int r=0; r<ranges; r++) {
+            range_start[r]=position;
+            for (int c=0; c<chunks; c++) {
+                int count=offsets[(size_t)c*ranges+r];
+                offsets[(size_t)c*ranges+r]=position;
+                position+=count;
+            }
+        }
+        range_start[ranges]=position;
+        std::vector<int> order(n); //indices of the elements, grouped by range
+        for (int c=0; c<chunks; c++) {
+            group.run([&, c]() {
+                for (int k=(int)((long long)n*c/chunks); k<(long long)n*(c+1)/chunks; k++)
+                    order[offsets[(size_t)c*ranges+(long long)bucket[k]*ranges/_size]++]=k;
+            });
+        }
+        group.wait();
+        
+        std::atomic<int> inserted(0);
+        for (int r=0; r<ranges; r++) {
+            group.run([&, r]() {
+                int count=0;
+                try {
+                    for (int j=range_start[r]; j<range_start[r+1]; j++)
+                        if (_array[bucket[order[j]]].try_emplace(first[order[j]])) count++;
+                }
+                catch(...) {
+                    inserted+=count;
+                    throw;
+                }
+                inserted+=count;
+            });
+        }
+        try {
+            group.wait();
+        }
+        catch(...) {
+            _insertions_num+=inserted;
+            throw;
+        }
+        _insertions_num+=inserted;
+        return inserted;
     }
     
     T & find (const T & val) {
+        if (!_size) throw dont_exist();
         int i=(_f)(val,_size);
+        long long compared=0;
+        T* found=_array[i].get_ptr(val, compared_in(compared));
+        Stats::count_comparisons(compared);
+        if (!found) throw dont_exist();
+        return *found;
+    }
+    
+    //same as find, but return NULL instead of throwing (cheaper on misses)
+    const T* find_ptr (const T & val) const {
+        if (!_size) return NULL;
+        int i=Func()(val,_size);
+        long long compared=0;
+        const T* found=static_cast<const Bucket &>(_array[i]).get_ptr(val, compared_in(compared));
+        Stats::count_comparisons(compared);
+        return found;
+    }
+    
+    T* find_ptr (const T & val) {
+        return const_cast<T*>(static_cast<const Hash_table*>(this)->find_ptr(val));
+    }
+    
+    /*----------------------------save / load---------------------------------*/
+private:
+    class Snapshot_header {
+    public:
+        char _magic[8];
+        uint32_t _elem_size;
+        int32_t _size;
+        int32_t _insertions_num;
+        int32_t _min_size;
+        float _max_load;
+        float _min_load;
+    };
+    
+    static void snapshot_magic (char* magic) {
+        memcpy(magic, "HTABLE1", 8);
+    }
+    
+public:
+    //can throw Snapshot_io_error, bad_alloc
+    void save (FILE* file) const {
+        static_assert(std::is_trivially_copyable<T>::value, "save writes the bytes of T");
+        Snapshot_writer out(file);
+        Snapshot_header header;
+        memset(&header, 0, sizeof(header));
+        snapshot_magic(header._magic);
+        header._elem_size=sizeof(T);
+        header._size=_size;
+        header._insertions_num=_insertions_num;
+        header._min_size=_min_size;
+        header._max_load=_max_load;
+        header._min_load=_min_load;
+        out.write_value(header);
+        for_each([&out](const T & val) {
+            int32_t code=val.operator()();
+            out.write_value(code);
+            out.write_value(val);
+        });
+        out.finish();
+    }
+    
+    void save (const char* path) const {
+        Snapshot_file file(path, "wb");
+        save(file.get());
+        file.close();
+    }
+    
+    /*replace the elements, the number of buckets and the load factors by the
+     ones of the snapshot. can throw Snapshot_io_error, Snapshot_corrupt,
+     bad_alloc : the table is then unchanged*/
+    void load (FILE* file) {
+        static_assert(std::is_trivially_copyable<T>::value, "load reads the bytes of T");
+        Snapshot_reader in(file);
+        Snapshot_header header;
+        in.read_value(header);
+        char magic[8];
+        snapshot_magic(magic);
+        if (memcmp(header._magic, magic, 8)!=0 || header._elem_size!=sizeof(T) || header._size<0 ||
+            header._insertions_num<0 || (header._size==0 && header._insertions_num>0) || header._min_size<0 ||
+            !(header._max_load>0 && header._min_load>=0 && 2*header._min_load<header._max_load))
+            throw Snapshot_corrupt();
+        Bucket* new_array=new_buckets(header._size);
         try {
-            return _array[i].List<T>::get_data(val);
-        } catch (typename List<T>::dont_exist &) {
-            throw dont_exist();
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type raw;
+            for (int k=0; k<header._insertions_num; k++) {
+                int32_t code;
+                in.read_value(code);
+                if (code<0) throw Snapshot_corrupt();
+                in.read(&raw, sizeof(T));
+                new_array[code%header._size].tail_insert(*reinterpret_cast<const T*>(&raw));
+            }
+            in.finish();
+        }
+        catch(...) {
+            delete_buckets(new_array, header._size);
+            throw;
         }
+        delete_buckets(_array, _size);
+        _array=new_array;
+        _size=header._size;
+        _insertions_num=header._insertions_num;
+        _min_size=header._min_size;
+        _reserved=0;
+        _max_load=header._max_load;
+        _min_load=header._min_load;
+    }
+    
+    void load (const char* path) {
+        Snapshot_file file(path, "rb");
+        load(file.get());
+    }
+    
+    /*find_ptr of the n keys, out[k] is the element equal to keys[k] or NULL.
+     return the number found. prefetch_group lookups are in flight at once
+     (see prefetch.hpp) : one step of each in turn, bucket, first node of the
+     chain, next nodes, so their cache misses overlap. needs the probe
+     methods of List in Bucket*/
+    int find_batch (const T* keys, int n, const T** out) const {
+        if (!_size) {
+            for (int k=0; k<n; k++) out[k]=NULL;
+            return 0;
+        }
+        class Lookup {
+        public:
+            int _key;
+            int _bucket;
+            int _step;
+            typename Bucket::Probe _probe;
+        };
+        Lookup group[prefetch_group];
+        int in_flight=0, next=0, found=0;
+        long long compared=0;
+        auto start=[&](Lookup & l) {
+            l._key=next++;
+            l._bucket=Func()(keys[l._key], _size);
+            l._step=0;
+            prefetch_read(&_array[l._bucket]);
+        };
+        while (in_flight<prefetch_group && next<n) start(group[in_flight++]);
+        while (in_flight) {
+            for (int s=0; s<in_flight; ) {
+                Lookup & l=group[s];
+                const Bucket & bucket=_array[l._bucket];
+                const T* result=NULL;
+                if (l._step==0) {
+                    bucket.prefetch();
+                    l._step=1;
+                }
+                else if (l._step==1) {
+                    l._probe=bucket.probe_begin();
+                    l._step=2;
+                }
+                else if (bucket.probe(l._probe, keys[l._key], result, compared_in(compared))) {
+                    out[l._key]=result;
+                    found+=result!=NULL;
+                    if (next<n) start(l);
+                    else {
+                        l=group[--in_flight]; //the last lookup takes the place, it steps now
+                        continue;
+                    }
+                }
+                s++;
+            }
+        }
+        Stats::count_comparisons(compared);
+        return found;
+    }
+    
+    //the same on a mutable table, out gets mutable elements
+    int find_batch (const T* keys, int n, T** out) {
+        return static_cast<const Hash_table*>(this)->find_batch(keys, n, const_cast<const T**>(out));
+    }
+    
+    //snapshot of the counters of Stats, with the histogram of the chain lengths
+    Container_stats stats () const {
+        Container_stats s=Stats::counters();
+        if constexpr (Stats::enabled) {
+            for (int i=0; i<_size; i++) {
+                int length=0;
+                _array[i].for_each([&length](const T &) { length++; });
+                s.add_chain(length);
+            }
+        }
+        return s;
+    }
+    
+    void reset_stats () {
+        Stats::reset_counters();
     }
 };
 #endif /* hash_table_hpp */
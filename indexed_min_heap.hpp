@@ -0,0 +1,158 @@
+//
+//  indexed_min_heap.hpp
+//  wet2
+//
+//  Min_heap of (key, priority) pairs that owns its key -> heap node index.
+//
+
+#ifndef indexed_min_heap_hpp
+#define indexed_min_heap_hpp
+#include <stdio.h>
+#include <cassert>
+#include "min_heap.hpp"
+#include "hash_table.hpp"
+
+/*
+ needed operators : == and default c'tor for Key, < for Priority.
+ Hash gives a non negative int for a Key (see Key_hash in hash_table.hpp).
+
+ The index maps a key to its Min_heap::Node. The heap already updates
+ Node::_index in the same pass as each sift, so reaching the position of a key
+ is one hash lookup and no extra bookkeeping is done while sifting.
+
+ push_or_decrease (key, prio); ...  O(log n)
+ contains (key); ...................  O(1) expected
+ priority (key); ...................  O(1) expected
+ erase (key); ......................  O(log n)
+ pop (); ...........................  O(log n)
+ */
+template <class Key, class Priority, class Hash = Key_hash<Key> >
+class Indexed_min_heap {
+
+    class Entry {
+    public:
+        Priority _prio;
+        Key _key;
+        Entry (const Key & key, const Priority & prio) : _prio(prio), _key(key) {}
+        bool operator<(const Entry & e) const {
+            return _prio < e._prio;
+        }
+    };
+
+    typedef typename Min_heap<Entry>::Node Heap_node;
+
+    class Handle {
+    public:
+        Key _key;
+        Heap_node* _node;
+        Handle () : _node(NULL) {}
+        Handle (const Key & key, Heap_node* node=NULL) : _key(key), _node(node) {}
+        bool operator==(const Handle & h) const {
+            return _key==h._key;
+        }
+        int operator()() const {
+            return Hash()(_key);
+        }
+    };
+
+    Min_heap<Entry> _heap;
+    Hash_table<Handle> _index;
+
+    Heap_node* node_of (const Key & key) { //can throw dont_exist
+        try {
+            return _index.find(Handle(key))._node;
+        }
+        catch (typename Hash_table<Handle>::dont_exist &) {
+            throw dont_exist();
+        }
+    }
+
+public:
+    class exception {};
+    class dont_exist : public exception {};
+    class Empty : public exception {};
+
+    //the heap and the index allocate from resource, global new/delete by default
+    explicit Indexed_min_heap (std::pmr::memory_resource* resource=std::pmr::get_default_resource()) :
+            _heap(resource), _index(10, 1.0f, 0.25f, resource) {}
+    Indexed_min_heap (const Indexed_min_heap &) = delete;
+    Indexed_min_heap & operator=(const Indexed_min_heap &) = delete;
+
+    /*insert key with priority prio, or lower its priority if key is already in
+     the heap. return false if key was there with a priority <= prio (nothing done).
+     can throw bad_alloc*/
+    bool push_or_decrease (const Key & key, const Priority & prio) {
+        Handle* handle;
+        try {
+            handle=&_index.find(Handle(key));
+        }
+        catch (typename Hash_table<Handle>::dont_exist &) {
+            Heap_node* node=_heap.insert(Entry(key, prio));
+            try {
+                _index.insert(Handle(key, node));
+            }
+            catch (std::bad_alloc &) {
+                _heap.Del(node->_index);
+                throw;
+            }
+            return true;
+        }
+        Heap_node* node=handle->_node;
+        if (!(prio < node->_data._prio)) return false;
+        _heap.Dec_key(node->_index, Entry(key, prio));
+        return true;
+    }
+
+    bool contains (const Key & key) {
+        try {
+            _index.find(Handle(key));
+        }
+        catch (typename Hash_table<Handle>::dont_exist &) {
+            return false;
+        }
+        return true;
+    }
+
+    const Priority & priority (const Key & key) { //can throw dont_exist
+        return node_of(key)->_data._prio;
+    }
+
+    void erase (const Key & key) { //can throw dont_exist
+        Heap_node* node=node_of(key);
+        _heap.Del(node->_index);
+        _index.erase(Handle(key));
+    }
+
+    const Key & top_key () const { //can throw Empty
+        try {
+            return _heap.find_min()._key;
+        }
+        catch (typename Min_heap<Entry>::Empty &) {
+            throw Empty();
+        }
+    }
+
+    const Priority & top_priority () const { //can throw Empty
+        try {
+            return _heap.find_min()._prio;
+        }
+        catch (typename Min_heap<Entry>::Empty &) {
+            throw Empty();
+        }
+    }
+
+    void pop () { //can throw Empty
+        Key key=top_key();
+        _heap.Del_min();
+        _index.erase(Handle(key));
+    }
+
+    int size () const {
+        return _heap.size();
+    }
+
+    bool is_empty () const {
+        return _heap.size()==0;
+    }
+};
+#endif /* indexed_min_heap_hpp */
@@ -10,6 +10,10 @@
 #define list_hpp
 #include <stdio.h>
 #include <cassert>
+#include <utility>
+#include <type_traits>
+#include "pmr.hpp"
+#include "prefetch.hpp"
 template <class T>
 class List {
     
@@ -19,63 +23,121 @@ public:
         T _data;
         Node* _next;
         Node() : _next(NULL) {} //suppose default c'tor for T
-        Node(T val) : _data(val), _next(NULL) {} //suppose copy c'tor for T
+        //build _data in place from args : copy, move or any c'tor of T
+        template <class... Args>
+        explicit Node(Args&&... args) : _data(std::forward<Args>(args)...), _next(NULL) {}
     };
 private:
+    std::pmr::memory_resource* _resource;
     Node* _dummie;
     Node* _last;
+    
+    template <class... Args>
+    Node* make_node (Args&&... args) { //can throw bad_alloc
+        return pmr_new<Node>(_resource, std::forward<Args>(args)...);
+    }
+    
+    void destroy_node (Node* node) {
+        pmr_delete(_resource, node);
+    }
+    
+    void link_head (Node* new_node) {
+        new_node->_next=_dummie->_next;
+        _dummie->_next=new_node;
+        if(!new_node->_next) _last=new_node;
+    }
+    
+    Node* link_tail (Node* new_node) {
+        _last->_next=new_node;
+        _last=new_node;
+        return _last;
+    }
+    
+    //return NULL if val is in the list, the last node otherwise
+    Node* exclusive_tail (const T & val) const {
+        Node* ptr=_dummie;
+        while(ptr->_next) {
+            if (ptr->_next->_data==val) return NULL;
+            ptr=ptr->_next;
+        }
+        return ptr;
+    }
 public:
     //exceptions :
     class exceptions {};
     class already_exist : public exceptions {};
     class dont_exist : public exceptions {};
     class Empty : public exceptions {};
-    List () {
-        _dummie=new Node(); //can throw bad_alloc
+    //nodes are allocated from resource, global new/delete by default
+    explicit List (std::pmr::memory_resource* resource=std::pmr::get_default_resource()) : _resource(resource) {
+        _dummie=make_node(); //can throw bad_alloc
         _last=_dummie;
     }
     
     ~List () {
+        //an arena frees the nodes itself, nothing to destroy in them
+        if(std::is_trivially_destructible<T>::value && pmr_releases_at_once(_resource)) return;
         Node* ptr=_dummie;
         while(ptr) {
             Node* to_destroy=ptr;
             ptr=ptr->_next;
-            delete to_destroy;
+            destroy_node(to_destroy);
         }
     }
     
     void head_insert (const T & val) { //can throw bad_alloc
-        Node* new_node=new Node(val);
-        Node* ptr=_dummie->_next;
-        _dummie->_next=new_node;
-        new_node->_next=ptr;
-        if(!new_node->_next) _last=new_node;
+        link_head(make_node(val));
+    }
+    
+    void head_insert (T && val) { //can throw bad_alloc
+        link_head(make_node(std::move(val)));
+    }
+    
+    template <class... Args>
+    void emplace_head (Args&&... args) { //can throw bad_alloc
+        link_head(make_node(std::forward<Args>(args)...));
     }
     
     /*don't allow identical objects, can throw bad alloc, can throw already exists,
      suppose == operator for T*/
     void exclusive_insert (const T & val) {
-        Node* new_node=new Node(val);
-        Node* ptr=_dummie;
-        while(ptr->_next) {
-            if (ptr->_next->_data==val) {
-                delete new_node;
-                throw already_exist();
-            }
-            ptr=ptr->_next;
-        }
-        ptr->_next=new_node;
-        _last=new_node;
+        if(!exclusive_tail(val)) throw already_exist();
+        link_tail(make_node(val));
     }
     
-    Node* tail_insert (const T & val) {
-        Node* new_node=new Node(val);
-        _last->_next=new_node;
-        _last = new_node;
-        return _last;
+    void exclusive_insert (T && val) {
+        if(!exclusive_tail(val)) throw already_exist();
+        link_tail(make_node(std::move(val)));
+    }
+    
+    /*build the element from args, insert it if it is not already in the list.
+     the node is allocated only after the scan. return false if already exists*/
+    template <class... Args>
+    bool try_emplace (Args&&... args) { //can throw bad_alloc
+        T val(std::forward<Args>(args)...);
+        if(!exclusive_tail(val)) return false;
+        link_tail(make_node(std::move(val)));
+        return true;
+    }
+    
+    Node* tail_insert (const T & val) { //can throw bad_alloc
+        return link_tail(make_node(val));
+    }
+    
+    Node* tail_insert (T && val) { //can throw bad_alloc
+        return link_tail(make_node(std::move(val)));
     }
     
-    void transfer_last (List & dst_list) { //*this, is the source list, non exclusive
+    template <class... Args>
+    Node* emplace_tail (Args&&... args) { //can throw bad_alloc
+        return link_tail(make_node(std::forward<Args>(args)...));
+    }
+    
+    static const bool transfer_allocates=false; //transfer_last relinks the node
+    
+    //*this, is the source list, non exclusive. both lists must use the same resource
+    void transfer_last (List & dst_list) {
+        assert(_resource==dst_list._resource);
         Node* ptr=_dummie;
         if(!_dummie->_next) throw Empty();
         Node* node_to_tranfer;
@@ -96,14 +158,92 @@ public:
     }
     
     T & get_data (const T & val) {
-        Node* ptr=_dummie->_next;
+        T* data=get_ptr(val);
+        if(!data) throw dont_exist();
+        return *data;
+    }
+    
+    /*same as get_data, but return NULL if val isn't in the list. the number
+     of elements compared with val is added to *compared, if not NULL*/
+    const T* get_ptr (const T & val, long long* compared=NULL) const {
+        long long n=0;
+        const Node* ptr=_dummie->_next;
         while(ptr) {
-            if (ptr->_data==val) return ptr->_data;
+            n++;
+            if (ptr->_data==val) break;
             ptr=ptr->_next;
         }
+        if(compared) *compared+=n;
+        return ptr ? &ptr->_data : NULL;
+    }
+    
+    T* get_ptr (const T & val, long long* compared=NULL) {
+        return const_cast<T*>(static_cast<const List*>(this)->get_ptr(val, compared));
+    }
+    
+    /*remove the node holding val, can throw dont_exist. suppose == operator for T.
+     compared as in get_ptr*/
+    void erase (const T & val, long long* compared=NULL) {
+        long long n=0;
+        Node* ptr=_dummie;
+        while(ptr->_next) {
+            n++;
+            if (ptr->_next->_data==val) {
+                if(compared) *compared+=n;
+                Node* to_destroy=ptr->_next;
+                ptr->_next=to_destroy->_next;
+                if(to_destroy==_last) _last=ptr;
+                destroy_node(to_destroy);
+                return;
+            }
+            ptr=ptr->_next;
+        }
+        if(compared) *compared+=n;
         throw dont_exist();
     }
     
+    template <class F>
+    void for_each (F f) const { //call f(const T &) on each element, in order
+        for (Node* ptr=_dummie->_next; ptr; ptr=ptr->_next) f(ptr->_data);
+    }
+    
+    /*get_ptr in steps, one node each, for Hash_table::find_batch : prefetch(),
+     probe_begin(), then probe() until it returns true. each step prefetches
+     the node the next one reads*/
+    typedef const Node* Probe;
+    
+    void prefetch () const {
+        prefetch_read(_dummie);
+    }
+    
+    Probe probe_begin () const {
+        Probe p=_dummie->_next;
+        prefetch_read(p);
+        return p;
+    }
+    
+    //true when the lookup is over, found is then the element or NULL. compared as in get_ptr
+    bool probe (Probe & p, const T & val, const T*& found, long long* compared=NULL) const {
+        if (p && compared) (*compared)++;
+        if (p && !(p->_data==val)) {
+            p=p->_next;
+            if (p) {
+                prefetch_read(p);
+                return false;
+            }
+        }
+        found = p ? &p->_data : NULL;
+        return true;
+    }
+    
+    bool is_empty () const {
+        return !_dummie->_next;
+    }
+    
+    std::pmr::memory_resource* resource () const {
+        return _resource;
+    }
+    
     T & get_last () {
         return _last->_data;
     }
@@ -112,7 +252,7 @@ public:
         Node* ptr=_dummie;
         while (ptr->_next->_next) ptr=ptr->_next;
         assert(ptr->_next==_last);
-        delete ptr->_next;
+        destroy_node(ptr->_next);
         ptr->_next=NULL;
         _last=ptr;
     }
@@ -0,0 +1,418 @@
+//
+//  lru_cache.hpp
+//  wet2
+//
+//  Fixed capacity caches over Hash_table : LRU, CLOCK and a sharded wrapper.
+//
+
+#ifndef lru_cache_hpp
+#define lru_cache_hpp
+#include <stdio.h>
+#include <cassert>
+#include <chrono>
+#include <mutex>
+#include <utility>
+#include "hash_table.hpp"
+#include "dlist.hpp"
+
+/*
+ needed operators : == and default c'tor for Key, default c'tor and
+ operator = for Value. Hash gives a non negative int for a Key
+ (see Key_hash in hash_table.hpp).
+
+ get, put, erase ..........  O(1) expected
+
+ Once the cache holds capacity keys, put of a new key evicts one :
+ Lru_cache ......  the least recently used key. The recency order is a Dlist,
+                   a hit moves its node at the head.
+ Clock_cache ....  CLOCK (second chance) : a hit only sets a reference bit,
+                   the hand clears the bits until it finds a victim.
+                   Less metadata and no list writes on hits.
+ Sharded_cache ..  N caches each behind its own mutex, for concurrent use.
+ */
+
+/*counters of a cache since its construction (or the last reset_stats)*/
+class Cache_stats {
+public:
+    long long _hits;
+    long long _misses;
+    long long _puts;
+    long long _evictions;
+    double _seconds;
+    Cache_stats () : _hits(0), _misses(0), _puts(0), _evictions(0), _seconds(0) {}
+
+    long long ops () const {
+        return _hits+_misses+_puts;
+    }
+    double hit_ratio () const {
+        return _hits+_misses ? (double)_hits/(_hits+_misses) : 0;
+    }
+    double ops_per_sec () const {
+        return _seconds>0 ? ops()/_seconds : 0;
+    }
+    Cache_stats & operator+=(const Cache_stats & s) {
+        _hits+=s._hits;
+        _misses+=s._misses;
+        _puts+=s._puts;
+        _evictions+=s._evictions;
+        if(s._seconds>_seconds) _seconds=s._seconds;
+        return *this;
+    }
+};
+
+/*the counting part shared by the caches*/
+class Cache_counters {
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point _start;
+protected:
+    Cache_stats _stats;
+public:
+    Cache_counters () : _start(Clock::now()) {}
+
+    Cache_stats stats () const {
+        Cache_stats s=_stats;
+        s._seconds=std::chrono::duration<double>(Clock::now()-_start).count();
+        return s;
+    }
+    void reset_stats () {
+        _stats=Cache_stats();
+        _start=Clock::now();
+    }
+};
+
+/*================================LRU cache===================================*/
+template <class Key, class Value, class Hash = Key_hash<Key> >
+class Lru_cache : public Cache_counters {
+
+    class Item {
+    public:
+        Key _key;
+        Value _value;
+        Item () {}
+        Item (const Key & key, const Value & value) : _key(key), _value(value) {}
+    };
+
+    typedef typename Dlist<Item>::Node Item_node;
+
+    class Handle {
+    public:
+        Key _key;
+        Item_node* _node;
+        Handle () : _node(NULL) {}
+        Handle (const Key & key, Item_node* node=NULL) : _key(key), _node(node) {}
+        bool operator==(const Handle & h) const {
+            return _key==h._key;
+        }
+        int operator()() const {
+            return Hash()(_key);
+        }
+    };
+
+    int _capacity;
+    Dlist<Item> _order; //most recently used at the head
+    Hash_table<Handle> _index;
+
+public:
+    typedef Key key_type;
+    typedef Value value_type;
+    typedef Hash hasher;
+
+    //the index is allocated for capacity keys, it never resizes
+    explicit Lru_cache (int capacity) : _capacity(capacity), _index(capacity) {
+        assert(capacity>0);
+    }
+    Lru_cache (const Lru_cache &) = delete;
+    Lru_cache & operator=(const Lru_cache &) = delete;
+
+    //return NULL on a miss. the pointer is valid until the key is evicted or erased
+    Value* get (const Key & key) {
+        Handle* handle=_index.find_ptr(Handle(key));
+        if(!handle) {
+            _stats._misses++;
+            return NULL;
+        }
+        _stats._hits++;
+        _order.move_to_head(handle->_node);
+        return &handle->_node->_data._value;
+    }
+
+    bool get (const Key & key, Value & out) {
+        Value* value=get(key);
+        if(!value) return false;
+        out=*value;
+        return true;
+    }
+
+    //insert or update key. can throw bad_alloc
+    void put (const Key & key, const Value & value) {
+        _stats._puts++;
+        Handle* handle=_index.find_ptr(Handle(key));
+        if(handle) {
+            handle->_node->_data._value=value;
+            _order.move_to_head(handle->_node);
+            return;
+        }
+        Item_node* node;
+        if(_index.size()==_capacity) { //recycle the node of the victim
+            node=_order.last();
+            _index.erase(Handle(node->_data._key));
+            _stats._evictions++;
+            node->_data._key=key;
+            node->_data._value=value;
+            _order.move_to_head(node);
+        }
+        else node=_order.head_insert(Item(key, value));
+        try {
+            _index.insert(Handle(key, node));
+        }
+        catch(std::bad_alloc &) {
+            _order.erase(node);
+            throw;
+        }
+    }
+
+    bool erase (const Key & key) {
+        Handle* handle=_index.find_ptr(Handle(key));
+        if(!handle) return false;
+        _order.erase(handle->_node);
+        _index.erase(Handle(key));
+        return true;
+    }
+
+    int size () const {
+        return _index.size();
+    }
+    int capacity () const {
+        return _capacity;
+    }
+};
+
+/*===============================CLOCK cache==================================*/
+template <class Key, class Value, class Hash = Key_hash<Key> >
+class Clock_cache : public Cache_counters {
+
+    class Slot {
+    public:
+        Key _key;
+        Value _value;
+        bool _referenced;
+        bool _used;
+        Slot () : _referenced(false), _used(false) {}
+    };
+
+    class Handle {
+    public:
+        Key _key;
+        int _slot;
+        Handle () : _slot(-1) {}
+        Handle (const Key & key, int slot=-1) : _key(key), _slot(slot) {}
+        bool operator==(const Handle & h) const {
+            return _key==h._key;
+        }
+        int operator()() const {
+            return Hash()(_key);
+        }
+    };
+
+    int _capacity;
+    Slot* _ring;
+    int _hand;
+    int* _free; //stack of the unused slots
+    int _free_num;
+    Hash_table<Handle> _index;
+
+    //turn the hand until a slot with no reference bit, return it
+    int sweep () {
+        while(_ring[_hand]._referenced) {
+            _ring[_hand]._referenced=false;
+            _hand=(_hand+1)%_capacity;
+        }
+        int victim=_hand;
+        _hand=(_hand+1)%_capacity;
+        return victim;
+    }
+
+public:
+    typedef Key key_type;
+    typedef Value value_type;
+    typedef Hash hasher;
+
+    explicit Clock_cache (int capacity) : _capacity(capacity), _hand(0), _free_num(capacity), _index(capacity) {
+        assert(capacity>0);
+        _ring=new Slot[capacity];
+        try {
+            _free=new int[capacity];
+        }
+        catch(std::bad_alloc &) {
+            delete [] _ring;
+            throw;
+        }
+        for (int i=0; i<capacity; i++) _free[i]=capacity-1-i;
+    }
+    ~Clock_cache () {
+        delete [] _ring;
+        delete [] _free;
+    }
+    Clock_cache (const Clock_cache &) = delete;
+    Clock_cache & operator=(const Clock_cache &) = delete;
+
+    //return NULL on a miss. the pointer is valid until the key is evicted or erased
+    Value* get (const Key & key) {
+        Handle* handle=_index.find_ptr(Handle(key));
+        if(!handle) {
+            _stats._misses++;
+            return NULL;
+        }
+        _stats._hits++;
+        Slot & slot=_ring[handle->_slot];
+        if(!slot._referenced) slot._referenced=true; //don't dirty the line on repeated hits
+        return &slot._value;
+    }
+
+    bool get (const Key & key, Value & out) {
+        Value* value=get(key);
+        if(!value) return false;
+        out=*value;
+        return true;
+    }
+
+    //insert or update key. can throw bad_alloc
+    void put (const Key & key, const Value & value) {
+        _stats._puts++;
+        Handle* handle=_index.find_ptr(Handle(key));
+        if(handle) {
+            _ring[handle->_slot]._value=value;
+            _ring[handle->_slot]._referenced=true;
+            return;
+        }
+        int i;
+        if(_free_num) i=_free[--_free_num];
+        else {
+            i=sweep();
+            assert(_ring[i]._used);
+            _index.erase(Handle(_ring[i]._key));
+            _stats._evictions++;
+        }
+        Slot & slot=_ring[i];
+        slot._key=key;
+        slot._value=value;
+        slot._referenced=false;
+        slot._used=true;
+        try {
+            _index.insert(Handle(key, i));
+        }
+        catch(std::bad_alloc &) {
+            slot._used=false;
+            _free[_free_num++]=i;
+            throw;
+        }
+    }
+
+    bool erase (const Key & key) {
+        Handle* handle=_index.find_ptr(Handle(key));
+        if(!handle) return false;
+        int i=handle->_slot;
+        _index.erase(Handle(key));
+        _ring[i]._used=false;
+        _ring[i]._referenced=false;
+        _free[_free_num++]=i;
+        return true;
+    }
+
+    int size () const {
+        return _index.size();
+    }
+    int capacity () const {
+        return _capacity;
+    }
+};
+
+/*=============================sharded cache==================================*/
+/*Cache is Lru_cache or Clock_cache. A key always goes to the same shard, the
+ capacity is split between the shards. get copies the value out, because a
+ pointer in a shard isn't safe once its lock is released.*/
+template <class Cache, int N=16>
+class Sharded_cache {
+    typedef typename Cache::key_type Key;
+    typedef typename Cache::value_type Value;
+    typedef typename Cache::hasher Hash;
+
+    class Shard {
+    public:
+        std::mutex _lock;
+        Cache _cache;
+        explicit Shard (int capacity) : _cache(capacity) {}
+    };
+
+    Shard* _shards[N];
+
+    //the high bits of the hash, the shard's index uses the low ones
+    Shard & shard (const Key & key) {
+        unsigned int h=(unsigned int)Hash()(key)*2654435761u;
+        return *_shards[(h>>16)%N];
+    }
+
+public:
+    explicit Sharded_cache (int capacity) {
+        assert(capacity>=N);
+        for (int i=0; i<N; i++) {
+            try {
+                _shards[i]=new Shard(capacity/N+(i<capacity%N));
+            }
+            catch(std::bad_alloc &) {
+                for (int j=0; j<i; j++) delete _shards[j];
+                throw;
+            }
+        }
+    }
+    ~Sharded_cache () {
+        for (int i=0; i<N; i++) delete _shards[i];
+    }
+    Sharded_cache (const Sharded_cache &) = delete;
+    Sharded_cache & operator=(const Sharded_cache &) = delete;
+
+    bool get (const Key & key, Value & out) {
+        Shard & s=shard(key);
+        std::lock_guard<std::mutex> guard(s._lock);
+        return s._cache.get(key, out);
+    }
+
+    void put (const Key & key, const Value & value) { //can throw bad_alloc
+        Shard & s=shard(key);
+        std::lock_guard<std::mutex> guard(s._lock);
+        s._cache.put(key, value);
+    }
+
+    bool erase (const Key & key) {
+        Shard & s=shard(key);
+        std::lock_guard<std::mutex> guard(s._lock);
+        return s._cache.erase(key);
+    }
+
+    //sum of the shards' counters
+    Cache_stats stats () {
+        Cache_stats total;
+        for (int i=0; i<N; i++) {
+            std::lock_guard<std::mutex> guard(_shards[i]->_lock);
+            total+=_shards[i]->_cache.stats();
+        }
+        return total;
+    }
+
+    void reset_stats () {
+        for (int i=0; i<N; i++) {
+            std::lock_guard<std::mutex> guard(_shards[i]->_lock);
+            _shards[i]->_cache.reset_stats();
+        }
+    }
+
+    int size () {
+        int total=0;
+        for (int i=0; i<N; i++) {
+            std::lock_guard<std::mutex> guard(_shards[i]->_lock);
+            total+=_shards[i]->_cache.size();
+        }
+        return total;
+    }
+};
+#endif /* lru_cache_hpp */
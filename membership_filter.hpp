@@ -0,0 +1,566 @@
+//
+//  membership_filter.hpp
+//  wet2
+//
+//  Bloom and cuckoo filters, and Hash_table / AVL_tree that ask them first.
+//
+
+#ifndef membership_filter_hpp
+#define membership_filter_hpp
+#include <stdio.h>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include "hash_table.hpp"
+#include "AVL_tree.hpp"
+
+/*
+ A filter answers "maybe in the set" or "surely not in the set". The
+ containers below consult it before searching, so most lookups of absent
+ keys stop after one or two cache line probes instead of a List chain walk or
+ a descent to the leaves of the tree.
+
+ Blocked_bloom_filter ..  all the bits of a key in one 64 bytes block : one
+                         cache line probe. No deletion : an erased key leaves
+                         its bits set until the next rebuild.
+ Cuckoo_filter .........  fingerprints in buckets of 4, a key is in one of
+                         two buckets : two probes at most. Supports deletion.
+
+ Both are built for an expected number of keys and a false positive rate.
+ The filters take 64 bits hashes, mix_hash (hash_table.hpp) spreads the int
+ hash of an element on 64 bits.
+ */
+
+/*what a filtered container reports about its filter*/
+class Filter_stats {
+public:
+    long long _queries; //lookups that asked the filter
+    long long _rejected; //answered "surely not" by the filter
+    long long _false_positives; //passed the filter, not found in the container
+    long long _rebuilds;
+    size_t _memory_bytes;
+    double _expected_fp_rate; //from the filter's parameters and load
+    bool _disabled; //no filter could be rebuilt, every lookup asks the container
+    Filter_stats () : _queries(0), _rejected(0), _false_positives(0), _rebuilds(0),
+            _memory_bytes(0), _expected_fp_rate(0), _disabled(false) {}
+
+    //false positives among the lookups of absent keys
+    double measured_fp_rate () const {
+        long long negatives=_rejected+_false_positives;
+        return negatives ? (double)_false_positives/negatives : 0;
+    }
+};
+
+/*=========================blocked Bloom filter===============================*/
+class Blocked_bloom_filter {
+    class alignas(64) Block {
+    public:
+        uint64_t _words[8];
+    };
+
+    Block* _blocks;
+    int _blocks_num;
+    int _k; //bits per key
+    int _capacity;
+    int _count;
+    double _fp_rate;
+
+    Block & block_of (uint64_t h) const { //the high bits of h select the block
+        return _blocks[(size_t)((h>>32)*(uint64_t)_blocks_num>>32)];
+    }
+
+public:
+    class exception {};
+    class full : public exception {}; //never thrown, same interface as Cuckoo_filter
+    static const bool can_erase=false;
+
+    Blocked_bloom_filter (int capacity, double fp_rate=0.01) :
+            _capacity(capacity>0 ? capacity : 1), _count(0), _fp_rate(fp_rate) {
+        assert(fp_rate>0 && fp_rate<1);
+        //optimal bits per key of a Bloom filter, +20% for the blocking
+        double bits_per_key=-std::log(fp_rate)/(std::log(2.0)*std::log(2.0))*1.2;
+        _k=(int)(bits_per_key*std::log(2.0)/1.2+0.5);
+        if(_k<1) _k=1;
+        if(_k>16) _k=16;
+        _blocks_num=(int)std::ceil(_capacity*bits_per_key/512);
+        if(_blocks_num<1) _blocks_num=1;
+        _blocks=new Block[_blocks_num];
+        clear();
+    }
+    ~Blocked_bloom_filter () {
+        delete [] _blocks;
+    }
+    Blocked_bloom_filter (const Blocked_bloom_filter &) = delete;
+    Blocked_bloom_filter & operator=(const Blocked_bloom_filter &) = delete;
+
+    void insert (uint64_t h) {
+        Block & b=block_of(h);
+        uint32_t h1=(uint32_t)h;
+        uint32_t h2=(uint32_t)(h>>32)|1;
+        for (int i=0; i<_k; i++) {
+            uint32_t bit=(h1+i*h2)&511;
+            b._words[bit>>6]|=1ULL<<(bit&63);
+        }
+        _count++;
+    }
+
+    bool may_contain (uint64_t h) const {
+        const Block & b=block_of(h);
+        uint32_t h1=(uint32_t)h;
+        uint32_t h2=(uint32_t)(h>>32)|1;
+        for (int i=0; i<_k; i++) {
+            uint32_t bit=(h1+i*h2)&511;
+            if(!(b._words[bit>>6]&(1ULL<<(bit&63)))) return false;
+        }
+        return true;
+    }
+
+    void clear () {
+        memset((void*)_blocks, 0, sizeof(Block)*_blocks_num);
+        _count=0;
+    }
+
+    int count () const {
+        return _count;
+    }
+    int capacity () const {
+        return _capacity;
+    }
+    size_t memory_bytes () const {
+        return sizeof(Block)*_blocks_num;
+    }
+    //classic Bloom estimate (1-e^(-kn/m))^k for the keys inserted so far
+    double expected_fp_rate () const {
+        double m=512.0*_blocks_num;
+        return std::pow(1-std::exp(-_k*(double)_count/m), _k);
+    }
+    double target_fp_rate () const {
+        return _fp_rate;
+    }
+};
+
+/*=============================cuckoo filter==================================*/
+class Cuckoo_filter {
+    enum { SLOTS=4, MAX_KICKS=500 };
+
+    uint16_t* _table; //SLOTS fingerprints per bucket, 0 is an empty slot
+    uint32_t _buckets_num; //power of 2
+    int _bits; //fingerprint size, up to 16
+    int _capacity;
+    int _count;
+    double _fp_rate;
+    uint16_t _victim; //fingerprint left homeless by a failed insert, 0 if none
+    uint32_t _victim_index;
+    uint32_t _seed;
+
+    uint16_t fingerprint (uint64_t h) const {
+        uint16_t fp=(uint16_t)((h>>32)&((1u<<_bits)-1));
+        return fp ? fp : 1;
+    }
+    uint32_t index (uint64_t h) const {
+        return (uint32_t)h&(_buckets_num-1);
+    }
+    uint32_t alt_index (uint32_t i, uint16_t fp) const { //alt_index(alt_index(i))==i
+        return (i^(uint32_t)mix_hash(fp))&(_buckets_num-1);
+    }
+    bool bucket_has (uint32_t i, uint16_t fp) const {
+        const uint16_t* b=_table+i*SLOTS;
+        return b[0]==fp || b[1]==fp || b[2]==fp || b[3]==fp;
+    }
+    bool bucket_add (uint32_t i, uint16_t fp) {
+        uint16_t* b=_table+i*SLOTS;
+        for (int s=0; s<SLOTS; s++) {
+            if(!b[s]) {
+                b[s]=fp;
+                return true;
+            }
+        }
+        return false;
+    }
+    bool bucket_remove (uint32_t i, uint16_t fp) {
+        uint16_t* b=_table+i*SLOTS;
+        for (int s=0; s<SLOTS; s++) {
+            if(b[s]==fp) {
+                b[s]=0;
+                return true;
+            }
+        }
+        return false;
+    }
+
+public:
+    class exception {};
+    class full : public exception {};
+    static const bool can_erase=true;
+
+    Cuckoo_filter (int capacity, double fp_rate=0.01) :
+            _capacity(capacity>0 ? capacity : 1), _count(0), _fp_rate(fp_rate),
+            _victim(0), _victim_index(0), _seed(0x2545f491) {
+        assert(fp_rate>0 && fp_rate<1);
+        //a lookup compares 2*SLOTS fingerprints : fp_rate ~ 2*SLOTS/2^bits
+        _bits=(int)std::ceil(std::log2(2.0*SLOTS/fp_rate));
+        if(_bits<4) _bits=4;
+        if(_bits>16) _bits=16;
+        //keep the load under 95%
+        _buckets_num=1;
+        while(_buckets_num*SLOTS*0.95<_capacity) _buckets_num*=2;
+        _table=new uint16_t[_buckets_num*SLOTS];
+        clear();
+    }
+    ~Cuckoo_filter () {
+        delete [] _table;
+    }
+    Cuckoo_filter (const Cuckoo_filter &) = delete;
+    Cuckoo_filter & operator=(const Cuckoo_filter &) = delete;
+
+    /*can throw full. if the kicks of this insert left a fingerprint homeless,
+     it is kept as the victim and the key is still found by may_contain. if a
+     victim was already there, the key is stored nowhere : may_contain can
+     miss it, the filter must be rebuilt before it is asked again*/
+    void insert (uint64_t h) {
+        if(_victim) throw full();
+        uint16_t fp=fingerprint(h);
+        uint32_t i1=index(h);
+        uint32_t i2=alt_index(i1, fp);
+        _count++;
+        if(bucket_add(i1, fp) || bucket_add(i2, fp)) return;
+        uint32_t i=(_seed&1) ? i1 : i2;
+        for (int kick=0; kick<MAX_KICKS; kick++) {
+            _seed=_seed*1103515245+12345;
+            uint16_t & slot=_table[i*SLOTS+(_seed>>16)%SLOTS];
+            uint16_t evicted=slot;
+            slot=fp;
+            fp=evicted;
+            i=alt_index(i, fp);
+            if(bucket_add(i, fp)) return;
+        }
+        _victim=fp;
+        _victim_index=i;
+        throw full();
+    }
+
+    bool may_contain (uint64_t h) const {
+        uint16_t fp=fingerprint(h);
+        uint32_t i1=index(h);
+        if(bucket_has(i1, fp) || bucket_has(alt_index(i1, fp), fp)) return true;
+        return _victim==fp && (_victim_index==i1 || _victim_index==alt_index(i1, fp));
+    }
+
+    //h must have been inserted
+    void erase (uint64_t h) {
+        uint16_t fp=fingerprint(h);
+        uint32_t i1=index(h);
+        uint32_t i2=alt_index(i1, fp);
+        if(bucket_remove(i1, fp) || bucket_remove(i2, fp)) {
+            _count--;
+            if(_victim) { //room for the homeless fingerprint maybe
+                uint16_t v=_victim;
+                uint32_t vi=_victim_index;
+                _victim=0;
+                if(!bucket_add(vi, v) && !bucket_add(alt_index(vi, v), v)) {
+                    _victim=v;
+                    _victim_index=vi;
+                }
+            }
+        }
+        else if(_victim==fp && (_victim_index==i1 || _victim_index==i2)) {
+            _victim=0;
+            _count--;
+        }
+    }
+
+    void clear () {
+        memset(_table, 0, sizeof(uint16_t)*_buckets_num*SLOTS);
+        _count=0;
+        _victim=0;
+    }
+
+    int count () const {
+        return _count;
+    }
+    int capacity () const {
+        return _capacity;
+    }
+    //fingerprints are stored on 16 bits whatever _bits is
+    size_t memory_bytes () const {
+        return sizeof(uint16_t)*_buckets_num*SLOTS;
+    }
+    double expected_fp_rate () const {
+        double load=(double)_count/(_buckets_num*SLOTS);
+        return 2.0*SLOTS*load/(1<<_bits);
+    }
+    double target_fp_rate () const {
+        return _fp_rate;
+    }
+};
+
+/*========================filtered containers=================================*/
+/*The filter is rebuilt from the container, twice as big, when it holds more
+ keys than its capacity (or a cuckoo filter is full). A Bloom filter is also
+ rebuilt when the erased keys it still holds reach a quarter of the keys in
+ the container : lookups of erased keys always pass it.
+
+ The new filter is filled aside and replaces the old one only once complete
+ (a cuckoo filter full before the end is tried again twice as big). When no
+ new filter can be built (bad_alloc, still full) and the old one may miss a
+ key, the filter is disabled : every lookup asks the container, until the
+ container doubles and a rebuild is tried again. A rebuild never throws, a
+ change of the container never fails because of its filter.*/
+template <class Filter>
+class Filter_holder {
+protected:
+    Filter* _filter;
+    double _fp_rate;
+    int _stale; //erased keys still set in a filter that can't erase
+    bool _disabled; //_filter may miss keys, it isn't asked
+    int _disabled_size; //size of the container when the filter was disabled
+    Filter_stats _stats;
+
+    Filter_holder (int capacity, double fp_rate) : _fp_rate(fp_rate), _stale(0), _disabled(false), _disabled_size(0) {
+        _filter=new Filter(capacity, fp_rate);
+    }
+    ~Filter_holder () {
+        delete _filter;
+    }
+
+    //the count of a filter that can't erase includes the stale keys
+    bool need_rebuild (int size) const {
+        if(_disabled) return size>=2*_disabled_size;
+        return _filter->count()>_filter->capacity() || 4*_stale>size;
+    }
+
+    /*new filter for size keys, filled by fill(Filter &), then put in place of
+     the old one. false if none could be built, the old one is then kept*/
+    template <class Fill>
+    bool renew (int size, Fill fill) {
+        int capacity=_filter->capacity();
+        while(capacity<2*size) capacity*=2;
+        for (int attempt=0; attempt<3; attempt++, capacity*=2) {
+            Filter* filter;
+            try {
+                filter=new Filter(capacity, _fp_rate);
+            }
+            catch(std::bad_alloc &) {
+                return false;
+            }
+            try {
+                fill(*filter);
+            }
+            catch(typename Filter::full &) {
+                delete filter;
+                continue;
+            }
+            delete _filter;
+            _filter=filter;
+            _stale=0;
+            _disabled=false;
+            _stats._rebuilds++;
+            return true;
+        }
+        return false;
+    }
+
+    //the old filter can miss a key : lookups stop asking it
+    void disable (int size) {
+        _disabled=true;
+        _disabled_size = size>0 ? size : 1;
+    }
+
+    //a negative lookup of the filter, and the container's answer when it is asked
+    bool filter_rejects (uint64_t h) {
+        if(_disabled) return false;
+        _stats._queries++;
+        if(_filter->may_contain(h)) return false;
+        _stats._rejected++;
+        return true;
+    }
+
+    //the container didn't find a key that passed the filter
+    void count_miss () {
+        if(!_disabled) _stats._false_positives++;
+    }
+
+    void filter_erase (uint64_t h, std::true_type) {
+        if(!_disabled) _filter->erase(h);
+    }
+    void filter_erase (uint64_t, std::false_type) {
+        _stale++;
+    }
+
+public:
+    Filter_holder (const Filter_holder &) = delete;
+    Filter_holder & operator=(const Filter_holder &) = delete;
+
+    Filter_stats filter_stats () const {
+        Filter_stats s=_stats;
+        s._memory_bytes=_filter->memory_bytes();
+        s._expected_fp_rate=_filter->expected_fp_rate();
+        s._disabled=_disabled;
+        return s;
+    }
+};
+
+/*Hash_table asking its filter before searching a bucket*/
+template <class T, class Filter = Blocked_bloom_filter, class Bucket = List<T>, class Hash = Key_hash<T> >
+class Filtered_hash_table : public Filter_holder<Filter> {
+    typedef Filter_holder<Filter> Base;
+    Hash_table<T, Bucket> _table;
+
+    static uint64_t hash (const T & val) {
+        return mix_hash((uint64_t)Hash()(val));
+    }
+
+    bool rebuild () { //false if the old filter is kept
+        return Base::renew(_table.size(), [this](Filter & filter) {
+            _table.for_each([&filter](const T & val) { filter.insert(hash(val)); });
+        });
+    }
+
+    void filter_insert (uint64_t h) {
+        if(this->_disabled) {
+            if(Base::need_rebuild(_table.size())) rebuild();
+            return;
+        }
+        try {
+            this->_filter->insert(h);
+        }
+        catch(typename Filter::full &) { //h may not be in : rebuilt from the container, or not asked anymore
+            if(!rebuild()) Base::disable(_table.size());
+            return;
+        }
+        if(Base::need_rebuild(_table.size())) rebuild(); //the old filter still has all the keys
+    }
+
+public:
+    typedef typename Hash_table<T, Bucket>::already_exist already_exist;
+    typedef typename Hash_table<T, Bucket>::dont_exist dont_exist;
+
+    explicit Filtered_hash_table (int expected=1024, double fp_rate=0.01) :
+            Base(expected, fp_rate) {}
+
+    void insert (const T & val) { //can throw bad alloc, already_exist
+        uint64_t h=hash(val);
+        _table.insert(val);
+        filter_insert(h);
+    }
+
+    void erase (const T & val) { //can throw dont_exist
+        uint64_t h=hash(val);
+        if(Base::filter_rejects(h)) throw dont_exist();
+        _table.erase(val);
+        Base::filter_erase(h, std::integral_constant<bool, Filter::can_erase>());
+        if(Base::need_rebuild(_table.size())) rebuild(); //if not, the old filter is still right, only less precise
+    }
+
+    T* find_ptr (const T & val) {
+        if(Base::filter_rejects(hash(val))) return NULL;
+        T* found=_table.find_ptr(val);
+        if(!found) Base::count_miss();
+        return found;
+    }
+
+    T & find (const T & val) { //can throw dont_exist
+        T* found=find_ptr(val);
+        if(!found) throw dont_exist();
+        return *found;
+    }
+
+    bool contains (const T & val) {
+        return find_ptr(val)!=NULL;
+    }
+
+    int size () const {
+        return _table.size();
+    }
+
+    const Hash_table<T, Bucket> & table () const {
+        return _table;
+    }
+};
+
+/*AVL_tree asking its filter before descending. The operator () of T is the
+ predicate of AVL_tree::operator+, so Hash must be given for class types.*/
+template <class T, class Hash = Key_hash<T>, class Filter = Blocked_bloom_filter>
+class Filtered_avl_tree : public Filter_holder<Filter> {
+    typedef Filter_holder<Filter> Base;
+    AVL_tree<T> _tree;
+    int _size;
+
+    static uint64_t hash (const T & val) {
+        return mix_hash((uint64_t)Hash()(val));
+    }
+
+    bool rebuild () { //false if the old filter is kept
+        return Base::renew(_size, [this](Filter & filter) {
+            for (typename AVL_tree<T>::inorder_iterator it=_tree.in_begin(); it!=_tree.in_end(); ++it)
+                filter.insert(hash(it.get_data()));
+        });
+    }
+
+    void filter_insert (uint64_t h) {
+        if(this->_disabled) {
+            if(Base::need_rebuild(_size)) rebuild();
+            return;
+        }
+        try {
+            this->_filter->insert(h);
+        }
+        catch(typename Filter::full &) { //h may not be in : rebuilt from the container, or not asked anymore
+            if(!rebuild()) Base::disable(_size);
+            return;
+        }
+        if(Base::need_rebuild(_size)) rebuild(); //the old filter still has all the keys
+    }
+
+public:
+    typedef typename AVL_tree<T>::key_not_found key_not_found;
+    typedef typename AVL_tree<T>::key_already_exists key_already_exists;
+
+    explicit Filtered_avl_tree (int expected=1024, double fp_rate=0.01) :
+            Base(expected, fp_rate), _size(0) {}
+
+    void balanced_insert (const T & val) { //can throw key_already_exists, bad_alloc
+        uint64_t h=hash(val);
+        _tree.balanced_insert(val);
+        _size++;
+        filter_insert(h);
+    }
+
+    void balanced_delete (const T & val) { //can throw key_not_found
+        uint64_t h=hash(val);
+        if(Base::filter_rejects(h)) throw key_not_found();
+        _tree.balanced_delete(val);
+        _size--;
+        Base::filter_erase(h, std::integral_constant<bool, Filter::can_erase>());
+        if(Base::need_rebuild(_size)) rebuild();
+    }
+
+    T* get_ptr (const T & val) {
+        if(Base::filter_rejects(hash(val))) return NULL;
+        T* found=_tree.get_ptr(val);
+        if(!found) Base::count_miss();
+        return found;
+    }
+
+    T & get (const T & val) { //can throw key_not_found
+        T* found=get_ptr(val);
+        if(!found) throw key_not_found();
+        return *found;
+    }
+
+    bool contains (const T & val) {
+        return get_ptr(val)!=NULL;
+    }
+
+    int size () const {
+        return _size;
+    }
+
+    const AVL_tree<T> & tree () const {
+        return _tree;
+    }
+};
+#endif /* membership_filter_hpp */
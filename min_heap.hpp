@@ -11,8 +11,19 @@
 #include <stdio.h>
 #include <new>
 #include <cassert>
-template <class T>
-class Min_heap {
+#include <utility>
+#include <type_traits>
+#include "pmr.hpp"
+#include "container_stats.hpp"
+#include "snapshot.hpp"
+/*Stats is the instrumentation policy (see container_stats.hpp)
+
+ save/load (T trivially copyable) write the heap as a snapshot (see
+ snapshot.hpp) : the elements in the order of the array. load puts each one
+ back at its index, the array is already a heap : no sift, no compare. The
+ Node* given out before a load don't point in the heap anymore.*/
+template <class T, class Stats = Null_stats>
+class Min_heap : private Stats {
     int _next_free_index;
     int _array_size;
     
@@ -21,35 +32,50 @@ public:
     public:
         int _index;
         T _data;
-        Node (int index, T val) : _index(index), _data(val) {} //c'tor for T
+        //build _data in place from args : copy, move or any c'tor of T
+        template <class... Args>
+        Node (int index, Args&&... args) : _index(index), _data(std::forward<Args>(args)...) {}
     };
     
 private:
+    std::pmr::memory_resource* _resource;
     Node** _array;
     
+    template <class... Args>
+    Node* make_node (Args&&... args) { //can throw bad_alloc
+        Stats::count_allocation();
+        return pmr_new<Node>(_resource, std::forward<Args>(args)...);
+    }
+    
+    void destroy_node (Node* node) {
+        pmr_delete(_resource, node);
+    }
+    
 public:
     class Empty {};
-    Min_heap (): _next_free_index(1), _array_size(10) {
-        _array = _array = new Node*[_array_size];
-        for (int i = 0; i < 10; i++) _array[i]=NULL;
+    //the array and the nodes are allocated from resource, global new/delete by default
+    explicit Min_heap (std::pmr::memory_resource* resource=std::pmr::get_default_resource()) :
+            _next_free_index(1), _array_size(10), _resource(resource) {
+        _array = pmr_new_array<Node*>(_resource, _array_size); //all NULL
     }
-    Min_heap (int n, T* array, Node** node_pointers)
+    Min_heap (int n, T* array, Node** node_pointers,
+              std::pmr::memory_resource* resource=std::pmr::get_default_resource()) : _resource(resource)
     {
         int closest_pow_of_2 = 1;
         while ( n >= closest_pow_of_2) closest_pow_of_2 *= 2;
         _array_size = closest_pow_of_2;
         _next_free_index = n+1;
-        _array = new Node*[_array_size];
+        _array = pmr_new_array<Node*>(_resource, _array_size);
         for ( int i = 0; i < _array_size; i++) {
             if (i == 0 || i >= _next_free_index ) _array[i] = NULL;
             else {
                 try {
-                    _array[i] = new Node(i, array[i-1]);
+                    _array[i] = make_node(i, array[i-1]);
                     node_pointers[i-1]=_array[i];
                 }
                 catch (std::bad_alloc &) {
-                    for (int j = 1; j < i; j++) delete _array[j];
-                    delete [] _array;
+                    for (int j = 1; j < i; j++) destroy_node(_array[j]);
+                    pmr_delete_array(_resource, _array, _array_size);
                     throw;
                 }
             }
@@ -59,21 +85,26 @@ public:
         
     }
     ~Min_heap () {
+        //an arena frees the array and the nodes itself, nothing to destroy in them
+        if (std::is_trivially_destructible<T>::value && pmr_releases_at_once(_resource)) return;
         for ( int i = 1; i < _next_free_index; i++)
-            delete _array[i];
+            destroy_node(_array[i]);
         
-        delete [] _array;
+        pmr_delete_array(_resource, _array, _array_size);
     }
     
     int sift_down (int i) {
         assert( 2*i < _next_free_index );
+        long long levels = 0, comparisons = 0;
+        auto less = [&comparisons](const T & a, const T & b) { comparisons++; return a < b; };
         while ( 2*i < _next_free_index ) {
             Node* father = _array[i];
             Node* left = _array[2*i];
             assert (left);
             Node* right=_array[2*i+1];
-            if ( father->_data < left->_data && (!right || father->_data < right->_data) ) break;
-            if ( !right || left->_data < right->_data ) {
+            if ( less(father->_data, left->_data) && (!right || less(father->_data, right->_data)) ) break;
+            levels++;
+            if ( !right || less(left->_data, right->_data) ) {
                 _array[i] = left;
                 left->_index = i;
                 _array[2*i] = father;
@@ -89,44 +120,59 @@ public:
                 i=2*i+1;
             }
         }
+        Stats::count_comparisons(comparisons);
+        Stats::count_sift_levels(levels);
         return i;
     }
     
     int sift_up (int i) {
         assert( i < _next_free_index );
+        long long levels = 0;
         while ( i > 1 ) {
             assert( i/2 >= 1 && i/2 < _next_free_index );
             Node* father = _array[i/2]; assert(father);
             Node* son = _array[i]; assert(son);
             
+            Stats::count_comparisons(1);
             if ( father->_data < son->_data ) break;
+            levels++;
             _array[i/2] = son;
             son->_index = i/2;
             _array[i] = father;
             father->_index = i;
             i=i/2;
         }
+        Stats::count_sift_levels(levels);
         return i;
     }
     
     Node* insert (const T & val) {
+        return emplace(val);
+    }
+    
+    Node* insert (T && val) {
+        return emplace(std::move(val));
+    }
+    
+    //build the new element in its node from args. can throw bad_alloc
+    template <class... Args>
+    Node* emplace (Args&&... args) {
         if ( _next_free_index < _array_size ) {
-            _array[_next_free_index] = new Node(_next_free_index, val);
+            _array[_next_free_index] = make_node(_next_free_index, std::forward<Args>(args)...);
             return _array[sift_up(_next_free_index++)];
         }
         assert(_next_free_index >= _array_size && _next_free_index < 2*_array_size);
-        Node** new_array = new Node*[2*_array_size];
+        Node** new_array = pmr_new_array<Node*>(_resource, 2*_array_size);
         for (int i=0 ; i<_next_free_index; i++)
             new_array[i] = _array[i];
         try {
-            new_array[_next_free_index] = new Node(_next_free_index, val);
+            new_array[_next_free_index] = make_node(_next_free_index, std::forward<Args>(args)...);
         }
         catch ( std::bad_alloc & ) {
-            delete [] new_array;
+            pmr_delete_array(_resource, new_array, 2*_array_size);
+            throw;
         }
-        for ( int i = _next_free_index+1; i < 2*_array_size; i++)
-            new_array[i] = NULL;
-        delete [] _array;
+        pmr_delete_array(_resource, _array, _array_size);
         _array = new_array;
         _array_size = 2*_array_size;
         return _array[sift_up(_next_free_index++)];
@@ -139,14 +185,142 @@ public:
         sift_up(i);
     }
     
+    void Dec_key ( int i, T && val ) {
+        assert(i < _next_free_index && i > 0);
+        Node* vertex = _array[i];
+        vertex->_data = std::move(val);
+        sift_up(i);
+    }
+    
+    //delete the node at index i, wherever it is in the heap
+    void Del ( int i ) {
+        assert(i < _next_free_index && i > 0);
+        destroy_node(_array[i]);
+        _array[i] = _array[_next_free_index-1];
+        _array[--_next_free_index] = NULL;
+        if ( i == _next_free_index ) return; //the last node was deleted
+        _array[i]->_index = i;
+        i = sift_up(i);
+        if ( 2*i < _next_free_index ) sift_down(i);
+    }
+    
+    int size () const {
+        return _next_free_index-1;
+    }
+    
+    std::pmr::memory_resource* resource () const {
+        return _resource;
+    }
+    
+    //snapshot of the counters of Stats
+    Container_stats stats () const {
+        return Stats::counters();
+    }
+    
+    void reset_stats () {
+        Stats::reset_counters();
+    }
+    
+    /*----------------------------save / load---------------------------------*/
+private:
+    class Snapshot_header {
+    public:
+        char _magic[8];
+        uint32_t _elem_size;
+        int32_t _size;
+        int32_t _array_size;
+        int32_t _zero;
+    };
+    
+    static void snapshot_magic (char* magic) {
+        memcpy(magic, "MINHEAP", 8);
+    }
+    
+public:
+    //can throw Snapshot_io_error, bad_alloc
+    void save (FILE* file) const {
+        static_assert(std::is_trivially_copyable<T>::value, "save writes the bytes of T");
+        Snapshot_writer out(file);
+        Snapshot_header header;
+        memset(&header, 0, sizeof(header));
+        snapshot_magic(header._magic);
+        header._elem_size = sizeof(T);
+        header._size = size();
+        header._array_size = _array_size;
+        out.write_value(header);
+        for ( int i = 1; i < _next_free_index; i++)
+            out.write_value(_array[i]->_data);
+        out.finish();
+    }
+    
+    void save (const char* path) const {
+        Snapshot_file file(path, "wb");
+        save(file.get());
+        file.close();
+    }
+    
+    /*replace the elements by the ones of the snapshot. can throw
+     Snapshot_io_error, Snapshot_corrupt, bad_alloc : the heap is then unchanged*/
+    void load (FILE* file) {
+        static_assert(std::is_trivially_copyable<T>::value, "load reads the bytes of T");
+        Snapshot_reader in(file);
+        Snapshot_header header;
+        in.read_value(header);
+        char magic[8];
+        snapshot_magic(magic);
+        if (memcmp(header._magic, magic, 8) != 0 || header._elem_size != sizeof(T) || header._size < 0 ||
+            header._array_size < 2 || header._size >= header._array_size || header._zero != 0)
+            throw Snapshot_corrupt();
+        Node** new_array = pmr_new_array<Node*>(_resource, header._array_size); //all NULL
+        int i = 1;
+        try {
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type raw;
+            for ( ; i <= header._size; i++) {
+                in.read(&raw, sizeof(T));
+                new_array[i] = make_node(i, *reinterpret_cast<const T*>(&raw));
+            }
+            in.finish();
+        }
+        catch (...) {
+            for (int j = 1; j < i; j++) destroy_node(new_array[j]);
+            pmr_delete_array(_resource, new_array, header._array_size);
+            throw;
+        }
+        for ( int j = 1; j < _next_free_index; j++)
+            destroy_node(_array[j]);
+        pmr_delete_array(_resource, _array, _array_size);
+        _array = new_array;
+        _array_size = header._array_size;
+        _next_free_index = header._size+1;
+    }
+    
+    void load (const char* path) {
+        Snapshot_file file(path, "rb");
+        load(file.get());
+    }
+    
     const T & find_min () const {
         if(_next_free_index <= 1) throw Empty();
         return _array[1]->_data;
     }
     
+    /*Del_min then insert(val) in one sift_down, reusing the node of the min
+     (a k-way merge replaces the head of the run it just output). can throw Empty*/
+    void replace_min (const T & val) {
+        if (_next_free_index == 1) throw Empty();
+        _array[1]->_data = val; //operator = for T
+        if (_next_free_index > 2) sift_down(1);
+    }
+    
+    void replace_min (T && val) {
+        if (_next_free_index == 1) throw Empty();
+        _array[1]->_data = std::move(val);
+        if (_next_free_index > 2) sift_down(1);
+    }
+    
     void Del_min () {
         if (_next_free_index == 1) throw Empty();
-        delete _array[1];
+        destroy_node(_array[1]);
         _array[1] = _array[_next_free_index-1];
         _array[--_next_free_index] = NULL;
         if(_array[1]) {
@@ -0,0 +1,77 @@
+//
+//  pmr.hpp
+//  wet2
+//
+//  Allocation of nodes and arrays from a std::pmr::memory_resource.
+//
+
+#ifndef pmr_hpp
+#define pmr_hpp
+#include <stdio.h>
+#include <memory_resource>
+#include <new>
+#include <utility>
+
+/*
+ The containers take a std::pmr::memory_resource* (the default resource,
+ global new/delete, when none is given) and get all their nodes and arrays
+ through these helpers. With a std::pmr::monotonic_buffer_resource per
+ request, everything a container allocated goes away with the arena.
+ */
+
+//build an X in memory of r. can throw bad_alloc and whatever the c'tor of X throws
+template <class X, class... Args>
+X* pmr_new (std::pmr::memory_resource* r, Args&&... args) {
+    void* p=r->allocate(sizeof(X), alignof(X));
+    try {
+        return ::new (p) X(std::forward<Args>(args)...);
+    }
+    catch(...) {
+        r->deallocate(p, sizeof(X), alignof(X));
+        throw;
+    }
+}
+
+template <class X>
+void pmr_delete (std::pmr::memory_resource* r, X* p) {
+    if(!p) return;
+    p->~X();
+    r->deallocate(p, sizeof(X), alignof(X));
+}
+
+//n X built with X(args...), value initialized if no args (NULL for pointers)
+template <class X, class... Args>
+X* pmr_new_array (std::pmr::memory_resource* r, int n, const Args&... args) {
+    X* p=(X*)r->allocate(sizeof(X)*n, alignof(X));
+    int i=0;
+    try {
+        for (; i<n; i++) ::new (p+i) X(args...);
+    }
+    catch(...) {
+        while(i--) p[i].~X();
+        r->deallocate(p, sizeof(X)*n, alignof(X));
+        throw;
+    }
+    return p;
+}
+
+template <class X>
+void pmr_delete_array (std::pmr::memory_resource* r, X* p, int n) {
+    if(!p) return;
+    for (int i=n-1; i>=0; i--) p[i].~X();
+    r->deallocate(p, sizeof(X)*n, alignof(X));
+}
+
+/*true when giving back memory to r does nothing and r frees everything at once :
+ a container of trivially destructible elements can skip walking its nodes
+ in its d'tor*/
+inline bool pmr_releases_at_once (std::pmr::memory_resource* r) {
+    return dynamic_cast<std::pmr::monotonic_buffer_resource*>(r)!=NULL;
+}
+
+/*true when r can be used by several threads at once : the parallel paths
+ (task_pool.hpp) allocate from the workers only then*/
+inline bool pmr_thread_safe (std::pmr::memory_resource* r) {
+    return r==std::pmr::new_delete_resource() || dynamic_cast<std::pmr::synchronized_pool_resource*>(r)!=NULL;
+}
+#endif /* pmr_hpp */
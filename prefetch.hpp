@@ -0,0 +1,28 @@
+//
+//  prefetch.hpp
+//  wet2
+//
+//  Software prefetch, for the batched lookups (find_batch).
+//
+
+#ifndef prefetch_hpp
+#define prefetch_hpp
+
+/*
+ A find_batch keeps prefetch_group lookups in flight and moves each one a
+ step (a bucket, a node, a level of a tree) in turn : the step prefetches
+ the next node of its lookup and goes on with the next lookup instead of
+ waiting, so the cache misses of the group overlap instead of following
+ each other. 16 is about the number of misses a core can have pending.
+ */
+const int prefetch_group=16;
+
+//ask for the cache line of p without waiting for it. p may be NULL
+inline void prefetch_read (const void* p) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(p, 0, 3);
+#else
+    (void)p;
+#endif
+}
+#endif /* prefetch_hpp */
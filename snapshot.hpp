@@ -0,0 +1,186 @@
+//
+//  snapshot.hpp
+//  wet2
+//
+//  Chunked, checksummed byte stream used by the save/load of the containers.
+//
+
+#ifndef snapshot_hpp
+#define snapshot_hpp
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+
+/*
+ A snapshot is a sequence of chunks :
+
+    uint32 bytes | uint32 0 | uint64 checksum of the bytes | bytes
+
+ ended by a chunk of 0 bytes. The writer fills a chunk in memory and writes
+ it in one fwrite, the reader checks each chunk before handing out its
+ bytes, so a file is streamed with one buffer of chunk size whatever its
+ length, and a truncated or damaged file is detected (Snapshot_corrupt)
+ instead of giving a wrong container.
+
+ What goes in the bytes is up to the container : a header (magic, sizeof T,
+ sizes) then its elements, raw (T trivially copyable).
+ */
+class Snapshot_error {};
+class Snapshot_io_error : public Snapshot_error {}; //fopen, fread, fwrite failed
+class Snapshot_corrupt : public Snapshot_error {}; //bad checksum, truncated, not the expected content
+
+/*64 bits checksum, 4 lanes of 8 bytes so it runs near memory bandwidth*/
+inline uint64_t snapshot_checksum (const void* data, size_t bytes) {
+    const uint64_t prime1=0x9e3779b185ebca87ULL, prime2=0xc2b2ae3d27d4eb4fULL;
+    const unsigned char* p=(const unsigned char*)data;
+    uint64_t lanes[4]={prime1, prime2, 0, ~prime1};
+    size_t i=0;
+    for (; i+32<=bytes; i+=32) {
+        for (int l=0; l<4; l++) {
+            uint64_t w;
+            memcpy(&w, p+i+8*l, 8);
+            lanes[l]+=w*prime2;
+            lanes[l]=(lanes[l]<<31 | lanes[l]>>33)*prime1;
+        }
+    }
+    uint64_t h=bytes*prime1;
+    for (int l=0; l<4; l++) h=(h^lanes[l])*prime1+prime2;
+    for (; i<bytes; i++) h=(h^p[i])*prime1;
+    h^=h>>29;
+    h*=prime2;
+    return h^(h>>32);
+}
+
+class Snapshot_chunk_header {
+public:
+    uint32_t _bytes;
+    uint32_t _zero;
+    uint64_t _checksum;
+};
+
+class Snapshot_writer {
+    FILE* _file;
+    std::vector<char> _buffer;
+    size_t _used;
+
+    void write_chunk (const char* data, size_t bytes) {
+        Snapshot_chunk_header header;
+        header._bytes=(uint32_t)bytes;
+        header._zero=0;
+        header._checksum=snapshot_checksum(data, bytes);
+        if(fwrite(&header, sizeof(header), 1, _file)!=1) throw Snapshot_io_error();
+        if(bytes && fwrite(data, 1, bytes, _file)!=bytes) throw Snapshot_io_error();
+    }
+
+public:
+    //can throw bad_alloc
+    explicit Snapshot_writer (FILE* file, size_t chunk_bytes=1<<20) : _file(file), _buffer(chunk_bytes), _used(0) {}
+
+    void write (const void* data, size_t bytes) { //can throw Snapshot_io_error
+        const char* p=(const char*)data;
+        while(bytes) {
+            size_t n=_buffer.size()-_used;
+            if(n>bytes) n=bytes;
+            memcpy(&_buffer[_used], p, n);
+            _used+=n;
+            p+=n;
+            bytes-=n;
+            if(_used==_buffer.size()) {
+                write_chunk(&_buffer[0], _used);
+                _used=0;
+            }
+        }
+    }
+
+    template <class X>
+    void write_value (const X & x) {
+        write(&x, sizeof(X));
+    }
+
+    //write the last chunk and the end mark. can throw Snapshot_io_error
+    void finish () {
+        if(_used) write_chunk(&_buffer[0], _used);
+        _used=0;
+        write_chunk(NULL, 0);
+        if(fflush(_file)!=0) throw Snapshot_io_error();
+    }
+};
+
+class Snapshot_reader {
+    FILE* _file;
+    std::vector<char> _buffer;
+    size_t _size;
+    size_t _pos;
+
+    //load the next chunk, return false at the end mark
+    bool next_chunk () {
+        Snapshot_chunk_header header;
+        if(fread(&header, sizeof(header), 1, _file)!=1) {
+            if(ferror(_file)) throw Snapshot_io_error();
+            throw Snapshot_corrupt(); //truncated
+        }
+        if(header._zero!=0 || header._bytes>max_chunk_bytes) throw Snapshot_corrupt();
+        if(header._bytes>_buffer.size()) _buffer.resize(header._bytes);
+        if(header._bytes && fread(&_buffer[0], 1, header._bytes, _file)!=header._bytes) {
+            if(ferror(_file)) throw Snapshot_io_error();
+            throw Snapshot_corrupt();
+        }
+        if(snapshot_checksum(_buffer.data(), header._bytes)!=header._checksum) throw Snapshot_corrupt();
+        _size=header._bytes;
+        _pos=0;
+        return _size!=0;
+    }
+
+public:
+    static const uint32_t max_chunk_bytes=1u<<26;
+
+    explicit Snapshot_reader (FILE* file) : _file(file), _size(0), _pos(0) {}
+
+    //can throw Snapshot_io_error, Snapshot_corrupt (the stream ends first), bad_alloc
+    void read (void* data, size_t bytes) {
+        char* p=(char*)data;
+        while(bytes) {
+            if(_pos==_size && !next_chunk()) throw Snapshot_corrupt();
+            size_t n=_size-_pos;
+            if(n>bytes) n=bytes;
+            memcpy(p, &_buffer[_pos], n);
+            _pos+=n;
+            p+=n;
+            bytes-=n;
+        }
+    }
+
+    template <class X>
+    void read_value (X & x) {
+        read(&x, sizeof(X));
+    }
+
+    //check that everything was read and the end mark follows
+    void finish () {
+        if(_pos!=_size || next_chunk()) throw Snapshot_corrupt();
+    }
+};
+
+/*fopen for save/load, closed by the d'tor (the error of fclose is checked by close)*/
+class Snapshot_file {
+    FILE* _file;
+public:
+    Snapshot_file (const char* path, const char* mode) : _file(fopen(path, mode)) {
+        if(!_file) throw Snapshot_io_error();
+    }
+    ~Snapshot_file () {
+        if(_file) fclose(_file);
+    }
+    Snapshot_file (const Snapshot_file &) = delete;
+    Snapshot_file & operator=(const Snapshot_file &) = delete;
+    FILE* get () const {
+        return _file;
+    }
+    void close () {
+        FILE* file=_file;
+        _file=NULL;
+        if(fclose(file)!=0) throw Snapshot_io_error();
+    }
+};
+#endif /* snapshot_hpp */
@@ -0,0 +1,468 @@
+//
+//  static_containers.hpp
+//  wet2
+//
+//  List, Hash_table, Min_heap and AVL_tree with inline storage of N elements.
+//
+
+#ifndef static_containers_hpp
+#define static_containers_hpp
+#include <stdio.h>
+#include <cassert>
+#include <utility>
+#include "hash_table.hpp"
+
+/*
+ The capacity N is a template parameter and the elements live inside the
+ object : constructing, filling and destroying one of these never calls the
+ allocator. Every method is constexpr, so a table can be built at compile
+ time (when T is a literal type) :
+
+    constexpr Static_hash_table<int, 8> make_table () {
+        Static_hash_table<int, 8> t;
+        t.insert(2); t.insert(3); t.insert(5); t.insert(7);
+        return t;
+    }
+    constexpr Static_hash_table<int, 8> primes=make_table();
+    static_assert(primes.contains(5), "");
+
+ Nothing throws : a full container or a missing key is reported by the
+ returned Static_status. Suppose default c'tor and operator = for T (all the
+ N slots are built with the container).
+ */
+enum class Static_status { ok, full, already_exist, dont_exist, empty };
+
+/*================================static list=================================*/
+/*doubly linked by indexes in the inline arrays, the unused slots form a free list*/
+template <class T, int N>
+class Static_list {
+    T _data[N] = {};
+    int _next[N] = {};
+    int _prev[N] = {};
+    int _first;
+    int _last;
+    int _free;
+    int _size;
+
+    constexpr int take_slot () {
+        int i=_free;
+        _free=_next[i];
+        return i;
+    }
+    constexpr void unlink (int i) {
+        if(_prev[i]>=0) _next[_prev[i]]=_next[i];
+        else _first=_next[i];
+        if(_next[i]>=0) _prev[_next[i]]=_prev[i];
+        else _last=_prev[i];
+        _next[i]=_free;
+        _free=i;
+        _size--;
+    }
+public:
+    constexpr Static_list () : _first(-1), _last(-1), _free(0), _size(0) {
+        for (int i=0; i<N; i++) _next[i]=i+1<N ? i+1 : -1;
+    }
+
+    constexpr Static_status head_insert (const T & val) {
+        if(_free<0) return Static_status::full;
+        int i=take_slot();
+        _data[i]=val;
+        _prev[i]=-1;
+        _next[i]=_first;
+        if(_first>=0) _prev[_first]=i;
+        else _last=i;
+        _first=i;
+        _size++;
+        return Static_status::ok;
+    }
+
+    constexpr Static_status tail_insert (const T & val) {
+        if(_free<0) return Static_status::full;
+        int i=take_slot();
+        _data[i]=val;
+        _next[i]=-1;
+        _prev[i]=_last;
+        if(_last>=0) _next[_last]=i;
+        else _first=i;
+        _last=i;
+        _size++;
+        return Static_status::ok;
+    }
+
+    //don't allow identical objects, suppose == operator for T
+    constexpr Static_status exclusive_insert (const T & val) {
+        if(get_ptr(val)) return Static_status::already_exist;
+        return tail_insert(val);
+    }
+
+    constexpr const T* get_ptr (const T & val) const {
+        for (int i=_first; i>=0; i=_next[i])
+            if(_data[i]==val) return &_data[i];
+        return nullptr;
+    }
+    constexpr T* get_ptr (const T & val) {
+        for (int i=_first; i>=0; i=_next[i])
+            if(_data[i]==val) return &_data[i];
+        return nullptr;
+    }
+
+    constexpr bool contains (const T & val) const {
+        return get_ptr(val)!=nullptr;
+    }
+
+    constexpr Static_status erase (const T & val) {
+        for (int i=_first; i>=0; i=_next[i]) {
+            if(_data[i]==val) {
+                unlink(i);
+                return Static_status::ok;
+            }
+        }
+        return Static_status::dont_exist;
+    }
+
+    constexpr Static_status delete_last () {
+        if(_last<0) return Static_status::empty;
+        unlink(_last);
+        return Static_status::ok;
+    }
+
+    constexpr const T* get_last () const { //nullptr if empty
+        return _last>=0 ? &_data[_last] : nullptr;
+    }
+
+    template <class F>
+    constexpr void for_each (F f) const { //call f(const T &) on each element, in order
+        for (int i=_first; i>=0; i=_next[i]) f(_data[i]);
+    }
+
+    constexpr bool is_empty () const {
+        return _size==0;
+    }
+    constexpr int size () const {
+        return _size;
+    }
+    static constexpr int capacity () {
+        return N;
+    }
+};
+
+/*=============================static hash table==============================*/
+/*open addressing with linear probing in a power of 2 number of slots, at most
+ half full. erase shifts the following keys back : no tombstones.
+ Hash as in Hash_table : operator () of T, see Key_hash.*/
+constexpr int static_slots_num (int n) { //power of 2 >= 2n
+    int s=1;
+    while(s<2*n) s*=2;
+    return s;
+}
+
+template <class T, int N, class Hash = Key_hash<T> >
+class Static_hash_table {
+    enum { S=static_slots_num(N) };
+
+    T _slots[S] = {};
+    bool _used[S] = {};
+    int _size;
+
+    static constexpr int home (const T & val) {
+        return Hash()(val)&(S-1);
+    }
+    //the slot of val, or the free slot where it would go
+    constexpr int probe (const T & val) const {
+        int i=home(val);
+        while(_used[i] && !(_slots[i]==val)) i=(i+1)&(S-1);
+        return i;
+    }
+public:
+    constexpr Static_hash_table () : _size(0) {}
+
+    constexpr Static_status insert (const T & val) {
+        int i=probe(val);
+        if(_used[i]) return Static_status::already_exist;
+        if(_size==N) return Static_status::full;
+        _slots[i]=val;
+        _used[i]=true;
+        _size++;
+        return Static_status::ok;
+    }
+
+    constexpr const T* find_ptr (const T & val) const {
+        int i=probe(val);
+        return _used[i] ? &_slots[i] : nullptr;
+    }
+    constexpr T* find_ptr (const T & val) {
+        int i=probe(val);
+        return _used[i] ? &_slots[i] : nullptr;
+    }
+
+    constexpr bool contains (const T & val) const {
+        return find_ptr(val)!=nullptr;
+    }
+
+    constexpr Static_status erase (const T & val) {
+        int hole=probe(val);
+        if(!_used[hole]) return Static_status::dont_exist;
+        //move back the keys of the cluster that can't be reached across the hole
+        for (int i=(hole+1)&(S-1); _used[i]; i=(i+1)&(S-1)) {
+            int h=home(_slots[i]);
+            bool reachable= hole<i ? (h>hole && h<=i) : (h>hole || h<=i);
+            if(reachable) continue;
+            _slots[hole]=std::move(_slots[i]);
+            hole=i;
+        }
+        _slots[hole]=T();
+        _used[hole]=false;
+        _size--;
+        return Static_status::ok;
+    }
+
+    template <class F>
+    constexpr void for_each (F f) const { //call f(const T &) on each element
+        for (int i=0; i<S; i++) if(_used[i]) f(_slots[i]);
+    }
+
+    constexpr int size () const {
+        return _size;
+    }
+    static constexpr int capacity () {
+        return N;
+    }
+};
+
+/*==============================static min heap===============================*/
+/*the elements themselves in the array (no Node), the root at index 1 as in Min_heap*/
+template <class T, int N>
+class Static_min_heap {
+    T _array[N+1] = {};
+    int _next_free_index;
+
+    constexpr void swap_slots (int i, int j) {
+        T temp=std::move(_array[i]);
+        _array[i]=std::move(_array[j]);
+        _array[j]=std::move(temp);
+    }
+public:
+    constexpr Static_min_heap () : _next_free_index(1) {}
+
+    constexpr int sift_up (int i) {
+        while(i>1 && _array[i]<_array[i/2]) {
+            swap_slots(i, i/2);
+            i/=2;
+        }
+        return i;
+    }
+
+    constexpr int sift_down (int i) {
+        while(2*i<_next_free_index) {
+            int son=2*i;
+            if(son+1<_next_free_index && _array[son+1]<_array[son]) son++;
+            if(!(_array[son]<_array[i])) break;
+            swap_slots(i, son);
+            i=son;
+        }
+        return i;
+    }
+
+    constexpr Static_status insert (const T & val) {
+        if(_next_free_index>N) return Static_status::full;
+        _array[_next_free_index]=val;
+        sift_up(_next_free_index++);
+        return Static_status::ok;
+    }
+
+    constexpr const T* find_min () const { //nullptr if empty
+        return _next_free_index>1 ? &_array[1] : nullptr;
+    }
+
+    constexpr Static_status Del_min () {
+        if(_next_free_index==1) return Static_status::empty;
+        _array[1]=std::move(_array[--_next_free_index]);
+        _array[_next_free_index]=T();
+        sift_down(1);
+        return Static_status::ok;
+    }
+
+    //replace the minimum by val, one sift down
+    constexpr Static_status replace_min (const T & val) {
+        if(_next_free_index==1) return Static_status::empty;
+        _array[1]=val;
+        sift_down(1);
+        return Static_status::ok;
+    }
+
+    constexpr int size () const {
+        return _next_free_index-1;
+    }
+    static constexpr int capacity () {
+        return N;
+    }
+};
+
+/*==============================static AVL tree===============================*/
+/*the nodes are slots of inline arrays linked by indexes, -1 is NULL. the same
+ rollings as AVL_tree, on indexes. needed operators for T : <, ==*/
+template <class T, int N>
+class Static_avl_tree {
+    T _data[N] = {};
+    int _left[N] = {};
+    int _right[N] = {};
+    int _height[N] = {};
+    int _root;
+    int _free; //free slots, linked by _left
+    int _size;
+
+    constexpr int H (int v) const {
+        return v<0 ? -1 : _height[v];
+    }
+    constexpr int BF (int v) const {
+        return H(_left[v])-H(_right[v]);
+    }
+    constexpr void update (int v) {
+        int h_l=H(_left[v]);
+        int h_r=H(_right[v]);
+        _height[v]=h_l>h_r ? h_l+1 : h_r+1;
+    }
+    constexpr int LL (int B) { //return the new root of the sub tree
+        int A=_left[B];
+        _left[B]=_right[A];
+        _right[A]=B;
+        update(B);
+        update(A);
+        return A;
+    }
+    constexpr int RR (int B) {
+        int A=_right[B];
+        _right[B]=_left[A];
+        _left[A]=B;
+        update(B);
+        update(A);
+        return A;
+    }
+    constexpr int rolling (int v) {
+        update(v);
+        if(BF(v)==2) {
+            if(BF(_left[v])<0) _left[v]=RR(_left[v]);
+            return LL(v);
+        }
+        if(BF(v)==-2) {
+            if(BF(_right[v])>0) _right[v]=LL(_right[v]);
+            return RR(v);
+        }
+        return v;
+    }
+    //insert in the sub tree of v, return its new root. status is set
+    constexpr int insert (int v, const T & val, Static_status & status) {
+        if(v<0) {
+            if(_free<0) {
+                status=Static_status::full;
+                return -1;
+            }
+            int node=_free;
+            _free=_left[node];
+            _data[node]=val;
+            _left[node]=-1;
+            _right[node]=-1;
+            _height[node]=0;
+            _size++;
+            status=Static_status::ok;
+            return node;
+        }
+        if(_data[v]==val) {
+            status=Static_status::already_exist;
+            return v;
+        }
+        if(_data[v]<val) _right[v]=insert(_right[v], val, status);
+        else _left[v]=insert(_left[v], val, status);
+        return status==Static_status::ok ? rolling(v) : v;
+    }
+    //detach the minimum of the sub tree of v in min, return the new root
+    constexpr int detach_min (int v, int & min) {
+        if(_left[v]<0) {
+            min=v;
+            return _right[v];
+        }
+        _left[v]=detach_min(_left[v], min);
+        return rolling(v);
+    }
+    constexpr int remove (int v, const T & val, Static_status & status) {
+        if(v<0) {
+            status=Static_status::dont_exist;
+            return -1;
+        }
+        if(_data[v]<val) _right[v]=remove(_right[v], val, status);
+        else if(!(_data[v]==val)) _left[v]=remove(_left[v], val, status);
+        else {
+            int replacement=_left[v]<0 ? _right[v] : _right[v]<0 ? _left[v] : -1;
+            if(_left[v]>=0 && _right[v]>=0) { //the next element takes the place of v
+                int next=-1;
+                int right=detach_min(_right[v], next);
+                _left[next]=_left[v];
+                _right[next]=right;
+                replacement=rolling(next);
+            }
+            _data[v]=T();
+            _left[v]=_free;
+            _free=v;
+            _size--;
+            status=Static_status::ok;
+            return replacement;
+        }
+        return status==Static_status::ok ? rolling(v) : v;
+    }
+    template <class F>
+    constexpr void inorder (int v, F & f) const {
+        if(v<0) return;
+        inorder(_left[v], f);
+        f(_data[v]);
+        inorder(_right[v], f);
+    }
+public:
+    constexpr Static_avl_tree () : _root(-1), _free(0), _size(0) {
+        for (int i=0; i<N; i++) _left[i]=i+1<N ? i+1 : -1;
+    }
+
+    constexpr Static_status balanced_insert (const T & val) {
+        Static_status status=Static_status::ok;
+        _root=insert(_root, val, status);
+        return status;
+    }
+
+    constexpr Static_status balanced_delete (const T & val) {
+        Static_status status=Static_status::ok;
+        _root=remove(_root, val, status);
+        return status;
+    }
+
+    constexpr const T* get_ptr (const T & val) const {
+        int v=_root;
+        while(v>=0) {
+            if(_data[v]<val) v=_right[v];
+            else if(_data[v]==val) return &_data[v];
+            else v=_left[v];
+        }
+        return nullptr;
+    }
+
+    constexpr bool contains (const T & val) const {
+        return get_ptr(val)!=nullptr;
+    }
+
+    template <class F>
+    constexpr void for_each (F f) const { //call f(const T &) on each element, in order
+        inorder(_root, f);
+    }
+
+    constexpr bool is_empty () const {
+        return _size==0;
+    }
+    constexpr int size () const {
+        return _size;
+    }
+    constexpr int height () const {
+        return H(_root);
+    }
+    static constexpr int capacity () {
+        return N;
+    }
+};
+#endif /* static_containers_hpp */
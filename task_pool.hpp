@@ -0,0 +1,265 @@
+//
+//  task_pool.hpp
+//  wet2
+//
+//  Work stealing thread pool, fork/join task groups and a parallel sort.
+//
+
+#ifndef task_pool_hpp
+#define task_pool_hpp
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ Each worker has its own deque of tasks : it pushes and pops the tasks it
+ spawns at the back (the last forked, still hot in its cache), an idle
+ worker steals the oldest task at the front of another deque (the biggest
+ piece of work in a fork/join recursion). Tasks submitted from outside the
+ pool go round robin to the deques.
+
+ A thread waiting for a Task_group runs tasks meanwhile instead of blocking,
+ so tasks can fork and wait for their own groups (recursive algorithms)
+ without running out of threads.
+ */
+class Task_pool {
+    class Task_queue {
+    public:
+        std::mutex _lock;
+        std::deque<std::function<void()> > _tasks;
+    };
+
+    int _threads_num;
+    std::unique_ptr<Task_queue[]> _queues;
+    std::vector<std::thread> _threads;
+    std::atomic<int> _queued;
+    std::atomic<unsigned> _next_queue;
+    std::atomic<bool> _stop;
+    std::mutex _idle_lock;
+    std::condition_variable _idle;
+
+    //the worker running on this thread, -1 outside of this pool
+    int worker_index () const {
+        return current_pool()==this ? current_index() : -1;
+    }
+    static const Task_pool*& current_pool () {
+        static thread_local const Task_pool* pool=NULL;
+        return pool;
+    }
+    static int& current_index () {
+        static thread_local int index=-1;
+        return index;
+    }
+
+    bool pop_back (int i, std::function<void()> & task) {
+        std::lock_guard<std::mutex> guard(_queues[i]._lock);
+        if(_queues[i]._tasks.empty()) return false;
+        task=std::move(_queues[i]._tasks.back());
+        _queues[i]._tasks.pop_back();
+        _queued--;
+        return true;
+    }
+
+    bool steal (int thief, std::function<void()> & task) {
+        int start = thief<0 ? 0 : thief+1;
+        for (int k=0; k<_threads_num; k++) {
+            Task_queue & q=_queues[(start+k)%_threads_num];
+            std::lock_guard<std::mutex> guard(q._lock);
+            if(q._tasks.empty()) continue;
+            task=std::move(q._tasks.front());
+            q._tasks.pop_front();
+            _queued--;
+            return true;
+        }
+        return false;
+    }
+
+    void worker_loop (int i) {
+        current_pool()=this;
+        current_index()=i;
+        std::function<void()> task;
+        while(true) {
+            if(pop_back(i, task) || steal(i, task)) {
+                task();
+                task=nullptr;
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(_idle_lock);
+            _idle.wait(lock, [this] { return _stop || _queued>0; });
+            if(_stop && _queued==0) return;
+        }
+    }
+
+public:
+    //threads=0 : one per hardware thread. can throw std::system_error, bad_alloc
+    explicit Task_pool (int threads=0) : _queued(0), _next_queue(0), _stop(false) {
+        if(threads<=0) threads=(int)std::thread::hardware_concurrency();
+        if(threads<=0) threads=1;
+        _threads_num=threads;
+        _queues.reset(new Task_queue[threads]);
+        try {
+            for (int i=0; i<threads; i++) _threads.push_back(std::thread(&Task_pool::worker_loop, this, i));
+        }
+        catch(...) {
+            shutdown();
+            throw;
+        }
+    }
+
+    //run the tasks left, then join the workers
+    ~Task_pool () {
+        shutdown();
+    }
+
+    Task_pool (const Task_pool &) = delete;
+    Task_pool & operator=(const Task_pool &) = delete;
+
+    //the pool used when none is given, built on first use
+    static Task_pool & shared () {
+        static Task_pool pool;
+        return pool;
+    }
+
+    int threads_num () const {
+        return _threads_num;
+    }
+
+    //a task spawned by a worker goes to its own deque. can throw bad_alloc
+    void submit (std::function<void()> task) {
+        int i=worker_index();
+        if(i<0) i=(int)(_next_queue++%(unsigned)_threads_num);
+        {
+            std::lock_guard<std::mutex> guard(_queues[i]._lock);
+            _queues[i]._tasks.push_back(std::move(task));
+        }
+        _queued++;
+        {
+            std::lock_guard<std::mutex> guard(_idle_lock);
+        }
+        _idle.notify_one();
+    }
+
+    //run one waiting task on the calling thread, return false if there was none
+    bool help () {
+        std::function<void()> task;
+        int i=worker_index();
+        if((i>=0 && pop_back(i, task)) || steal(i, task)) {
+            task();
+            return true;
+        }
+        return false;
+    }
+
+private:
+    void shutdown () {
+        {
+            std::lock_guard<std::mutex> guard(_idle_lock);
+            _stop=true;
+        }
+        _idle.notify_all();
+        for (size_t i=0; i<_threads.size(); i++) _threads[i].join();
+        _threads.clear();
+    }
+};
+
+/*fork/join : run() forks a task, wait() joins all of them and rethrows the
+ first exception one threw. The d'tor waits too (an exception is then lost).*/
+class Task_group {
+    Task_pool & _pool;
+    std::atomic<int> _pending;
+    std::mutex _error_lock;
+    std::exception_ptr _error;
+
+public:
+    explicit Task_group (Task_pool & pool=Task_pool::shared()) : _pool(pool), _pending(0) {}
+    ~Task_group () {
+        try {
+            wait();
+        }
+        catch(...) {}
+    }
+    Task_group (const Task_group &) = delete;
+    Task_group & operator=(const Task_group &) = delete;
+
+    template <class F>
+    void run (F f) { //can throw bad_alloc
+        _pending++;
+        try {
+            _pool.submit([this, f]() mutable {
+                try {
+                    f();
+                }
+                catch(...) {
+                    std::lock_guard<std::mutex> guard(_error_lock);
+                    if(!_error) _error=std::current_exception();
+                }
+                _pending--; //the last use of this
+            });
+        }
+        catch(...) {
+            _pending--;
+            throw;
+        }
+    }
+
+    void wait () {
+        while(_pending>0) {
+            if(!_pool.help()) std::this_thread::yield();
+        }
+        if(_error) {
+            std::exception_ptr error=_error;
+            _error=nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+};
+
+/*call f(from, to) on consecutive pieces of [begin, end), about 4 per thread
+ (room for stealing when the pieces don't cost the same), in parallel*/
+template <class F>
+void parallel_ranges (long long begin, long long end, F f, Task_pool & pool=Task_pool::shared()) {
+    long long n=end-begin;
+    if(n<=0) return;
+    long long pieces=4LL*pool.threads_num();
+    if(pieces>n) pieces=n;
+    Task_group group(pool);
+    for (long long p=1; p<pieces; p++) {
+        long long from=begin+n*p/pieces, to=begin+n*(p+1)/pieces;
+        group.run([&f, from, to]() { f(from, to); });
+    }
+    f(begin, begin+n/pieces);
+    group.wait();
+}
+
+/*merge sort : the halves are sorted in parallel down to pieces of cutoff
+ elements (std::sort), then merged in place. can throw bad_alloc*/
+template <class It, class Less>
+void parallel_sort (It first, It last, Less less, Task_pool & pool=Task_pool::shared(), long long cutoff=1<<14) {
+    long long n=std::distance(first, last);
+    if(n<=cutoff) {
+        std::sort(first, last, less);
+        return;
+    }
+    It mid=first+n/2;
+    Task_group group(pool);
+    group.run([first, mid, less, &pool, cutoff]() { parallel_sort(first, mid, less, pool, cutoff); });
+    parallel_sort(mid, last, less, pool, cutoff);
+    group.wait();
+    std::inplace_merge(first, mid, last, less);
+}
+
+//sort with operator <, on the shared pool
+template <class It>
+void parallel_sort (It first, It last) {
+    parallel_sort(first, last, std::less<typename std::iterator_traits<It>::value_type>());
+}
+#endif /* task_pool_hpp */
@@ -0,0 +1,286 @@
+//
+//  unrolled_list.hpp
+//  wet2
+//
+//  List storing up to B elements per block : same interface as List.
+//
+
+#ifndef unrolled_list_hpp
+#define unrolled_list_hpp
+#include <stdio.h>
+#include <cassert>
+#include <utility>
+#include <type_traits>
+#include "pmr.hpp"
+#include "prefetch.hpp"
+
+/*
+ The elements are packed in cache line aligned blocks of B elements, the
+ blocks are doubly linked. A scan reads B contiguous elements between two
+ pointer loads instead of one. Can be used as the bucket type of Hash_table.
+
+ head_insert ................  O(B)
+ tail_insert, delete_last ...  O(1)
+ transfer_last ..............  O(1), can allocate a block
+ get_data, erase ............  O(n)
+
+ Suppose default c'tor and operator = for T (the slots of a block are
+ default constructed, emplace builds a T and moves it in its slot). The
+ elements move inside their block, so a reference returned by get_data
+ stays valid only until the next insert or delete.
+ */
+template <class T, int B=16>
+class Unrolled_list {
+
+public:
+    class alignas(64) Block {
+    public:
+        T _data[B];
+        int _count;
+        Block* _next;
+        Block* _prev;
+        Block() : _count(0), _next(NULL), _prev(NULL) {}
+    };
+private:
+    std::pmr::memory_resource* _resource;
+    Block* _first;
+    Block* _last;
+
+    Block* new_block_after (Block* prev) { //can throw bad_alloc
+        Block* block=pmr_new<Block>(_resource);
+        block->_prev=prev;
+        block->_next=prev ? prev->_next : _first;
+        if(block->_next) block->_next->_prev=block;
+        else _last=block;
+        if(prev) prev->_next=block;
+        else _first=block;
+        return block;
+    }
+
+    void delete_block (Block* block) {
+        assert(block->_count==0);
+        if(block->_prev) block->_prev->_next=block->_next;
+        else _first=block->_next;
+        if(block->_next) block->_next->_prev=block->_prev;
+        else _last=block->_prev;
+        pmr_delete(_resource, block);
+    }
+
+    //make room at the front of the list, return the free slot
+    T & head_slot () { //can throw bad_alloc
+        Block* block=_first;
+        if(!block || block->_count==B) block=new_block_after(NULL);
+        for (int j=block->_count; j>0; j--)
+            block->_data[j]=std::move(block->_data[j-1]);
+        block->_count++;
+        return block->_data[0];
+    }
+
+    T & tail_slot () { //can throw bad_alloc
+        Block* block=_last;
+        if(!block || block->_count==B) block=new_block_after(_last);
+        return block->_data[block->_count++];
+    }
+
+    //the place of val : its block (NULL if val isn't in the list) and index
+    int find_slot (const T & val, Block*& block, long long* compared) const {
+        long long n=0;
+        for (block=_first; block; block=block->_next) {
+            for (int i=0; i<block->_count; i++) {
+                if (block->_data[i]==val) {
+                    if(compared) *compared+=n+i+1;
+                    return i;
+                }
+            }
+            n+=block->_count;
+        }
+        if(compared) *compared+=n;
+        return 0;
+    }
+
+    void remove_at (Block* block, int i) {
+        for (int j=i; j+1<block->_count; j++)
+            block->_data[j]=std::move(block->_data[j+1]);
+        block->_data[--block->_count]=T(); //release what the element held
+        if(block->_count==0) delete_block(block);
+    }
+public:
+    //exceptions :
+    class exceptions {};
+    class already_exist : public exceptions {};
+    class dont_exist : public exceptions {};
+    class Empty : public exceptions {};
+    //blocks are allocated from resource, global new/delete by default
+    explicit Unrolled_list (std::pmr::memory_resource* resource=std::pmr::get_default_resource()) : _resource(resource), _first(NULL), _last(NULL) {}
+
+    ~Unrolled_list () {
+        //an arena frees the blocks itself, nothing to destroy in them
+        if(std::is_trivially_destructible<T>::value && pmr_releases_at_once(_resource)) return;
+        Block* ptr=_first;
+        while(ptr) {
+            Block* to_destroy=ptr;
+            ptr=ptr->_next;
+            pmr_delete(_resource, to_destroy);
+        }
+    }
+
+    Unrolled_list (const Unrolled_list &) = delete;
+    Unrolled_list & operator=(const Unrolled_list &) = delete;
+
+    void head_insert (const T & val) { //can throw bad_alloc
+        T & slot=head_slot();
+        slot=val;
+    }
+
+    void head_insert (T && val) { //can throw bad_alloc
+        T & slot=head_slot();
+        slot=std::move(val);
+    }
+
+    template <class... Args>
+    void emplace_head (Args&&... args) { //can throw bad_alloc
+        head_insert(T(std::forward<Args>(args)...));
+    }
+
+    /*don't allow identical objects, can throw bad alloc, can throw already exists,
+     suppose == operator for T*/
+    void exclusive_insert (const T & val) {
+        if(contains(val)) throw already_exist();
+        tail_insert(val);
+    }
+
+    void exclusive_insert (T && val) {
+        if(contains(val)) throw already_exist();
+        tail_insert(std::move(val));
+    }
+
+    //build the element from args, insert it if it is not already in the list
+    template <class... Args>
+    bool try_emplace (Args&&... args) { //can throw bad_alloc
+        T val(std::forward<Args>(args)...);
+        if(contains(val)) return false;
+        tail_insert(std::move(val));
+        return true;
+    }
+
+    T & tail_insert (const T & val) { //can throw bad_alloc
+        T & slot=tail_slot();
+        slot=val;
+        return slot;
+    }
+
+    T & tail_insert (T && val) { //can throw bad_alloc
+        T & slot=tail_slot();
+        slot=std::move(val);
+        return slot;
+    }
+
+    template <class... Args>
+    T & emplace_tail (Args&&... args) { //can throw bad_alloc
+        return tail_insert(T(std::forward<Args>(args)...));
+    }
+
+    bool contains (const T & val) const {
+        return get_ptr(val)!=NULL;
+    }
+
+    static const bool transfer_allocates=true; //transfer_last can need a new block in dst_list
+
+    /*the last element is moved at the tail of dst_list (*this, is the source
+     list, non exclusive). can throw bad_alloc, both lists are then unchanged*/
+    void transfer_last (Unrolled_list & dst_list) {
+        if(is_empty()) throw Empty();
+        dst_list.tail_insert(std::move(get_last())); //can throw bad_alloc
+        delete_last();
+    }
+
+    std::pmr::memory_resource* resource () const {
+        return _resource;
+    }
+
+    T & get_data (const T & val) {
+        T* data=get_ptr(val);
+        if(!data) throw dont_exist();
+        return *data;
+    }
+
+    /*same as get_data, but return NULL if val isn't in the list. the number
+     of elements compared with val is added to *compared, if not NULL*/
+    const T* get_ptr (const T & val, long long* compared=NULL) const {
+        Block* block;
+        int i=find_slot(val, block, compared);
+        return block ? &block->_data[i] : NULL;
+    }
+
+    T* get_ptr (const T & val, long long* compared=NULL) {
+        Block* block;
+        int i=find_slot(val, block, compared);
+        return block ? &block->_data[i] : NULL;
+    }
+
+    template <class F>
+    void for_each (F f) const { //call f(const T &) on each element, in order
+        for (Block* block=_first; block; block=block->_next)
+            for (int i=0; i<block->_count; i++) f(block->_data[i]);
+    }
+
+    /*get_ptr in steps, for Hash_table::find_batch (see List::probe) : a step
+     searches a whole block. the first line of the block and the one of
+     _count are prefetched, the hardware prefetcher follows the others*/
+    typedef const Block* Probe;
+
+    static void prefetch_block (const Block* block) {
+        if (!block) return;
+        prefetch_read(block);
+        prefetch_read(&block->_count);
+    }
+
+    void prefetch () const {
+        prefetch_block(_first);
+    }
+
+    Probe probe_begin () const {
+        return _first;
+    }
+
+    bool probe (Probe & p, const T & val, const T*& found, long long* compared=NULL) const {
+        found=NULL;
+        if (!p) return true;
+        for (int i=0; i<p->_count; i++) {
+            if (p->_data[i]==val) {
+                if (compared) *compared+=i+1;
+                found=&p->_data[i];
+                return true;
+            }
+        }
+        if (compared) *compared+=p->_count;
+        p=p->_next;
+        prefetch_block(p);
+        return !p;
+    }
+
+    bool is_empty () const {
+        return !_first;
+    }
+
+    T & get_last () {
+        assert(_last);
+        return _last->_data[_last->_count-1];
+    }
+
+    void delete_last () {
+        assert(_last);
+        _last->_data[--_last->_count]=T();
+        if(_last->_count==0) delete_block(_last);
+    }
+
+    /*remove the element equal to val, can throw dont_exist. suppose == operator for T.
+     compared as in get_ptr*/
+    void erase (const T & val, long long* compared=NULL) {
+        Block* block;
+        int i=find_slot(val, block, compared);
+        if(!block) throw dont_exist();
+        remove_at(block, i);
+    }
+};
+#endif /* unrolled_list_hpp */